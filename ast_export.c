@@ -0,0 +1,220 @@
+#include "ast_export.h"
+#include "json.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+const char *node_type_name(NodeType type) {
+    static const char *names[] = {
+        "file", "command_invocation", "identifier", "unquoted_argument", "quoted_argument",
+        "bracket_argument", "line_comment", "bracket_comment", "lparen", "rparen",
+    };
+    return (size_t)type < sizeof(names) / sizeof(names[0]) ? names[type] : "unknown";
+}
+
+const char *token_type_name(TokenType type) {
+    static const char *names[] = {
+        "error", "eof", "lparen", "rparen", "identifier", "unquoted_argument", "quoted_argument",
+        "bracket_argument", "line_comment", "bracket_comment", "space", "newline",
+    };
+    return (size_t)type < sizeof(names) / sizeof(names[0]) ? names[type] : "unknown";
+}
+
+static bool is_leaf(const ASTNode *node) {
+    return node->type != NODE_FILE && node->type != NODE_COMMAND_INVOCATION;
+}
+
+static void node_range(const ASTNode *node, size_t length, SourceOffset *start, SourceOffset *end) {
+    if (node->type == NODE_FILE) {
+        *start = 0;
+        *end = (SourceOffset)length;
+    } else {
+        *start = node->token.offset;
+        *end = ast_node_end(node);
+    }
+}
+
+// Whitespace runs are only written when present.
+static void write_json_trivia(FormatBuffer *out, const char *key, Trivia trivia) {
+    if (trivia.newlines == 0 && trivia.spaces == 0) return;
+    json_write_raw(out, ",\"");
+    json_write_raw(out, key);
+    json_write_raw(out, "\":{\"newlines\":");
+    json_write_int(out, trivia.newlines);
+    json_write_raw(out, ",\"spaces\":");
+    json_write_int(out, trivia.spaces);
+    json_write_raw(out, "}");
+}
+
+static void write_json_node(const ASTNode *node, const char *source, size_t length,
+                            const LineIndex *lines, FormatBuffer *out) {
+    SourceOffset start, end;
+    int line, column;
+    node_range(node, length, &start, &end);
+    line_index_lookup(lines, start, &line, &column);
+
+    json_write_raw(out, "{\"type\":\"");
+    json_write_raw(out, node_type_name(node->type));
+    json_write_raw(out, "\"");
+    if (is_leaf(node)) {
+        json_write_raw(out, ",\"token\":\"");
+        json_write_raw(out, token_type_name(node->token.type));
+        json_write_raw(out, "\"");
+    }
+    json_write_raw(out, ",\"start\":");
+    json_write_int(out, (long long)start);
+    json_write_raw(out, ",\"end\":");
+    json_write_int(out, (long long)end);
+    json_write_raw(out, ",\"line\":");
+    json_write_int(out, line);
+    json_write_raw(out, ",\"column\":");
+    json_write_int(out, column);
+    write_json_trivia(out, "leading", node->leading);
+    if (!is_leaf(node)) write_json_trivia(out, "trailing", node->trailing);
+    if (is_leaf(node)) {
+        json_write_raw(out, ",\"text\":");
+        json_write_string(out, token_text(source, node->token), node->token.length);
+    } else {
+        json_write_raw(out, ",\"children\":[");
+        for (size_t i = 0; i < node->child_count; i++) {
+            if (i > 0) json_write_raw(out, ",");
+            write_json_node(node->children[i], source, length, lines, out);
+        }
+        json_write_raw(out, "]");
+    }
+    json_write_raw(out, "}");
+}
+
+void ast_export_json(const ASTNode *root, const char *path, const char *source, size_t length,
+                     FormatBuffer *out) {
+    LineIndex lines;
+    line_index_build(&lines, source, length);
+
+    json_write_raw(out, "{\"version\":2,\"path\":");
+    json_write_string(out, path, strlen(path));
+    json_write_raw(out, ",\"root\":");
+    write_json_node(root, source, length, &lines, out);
+    json_write_raw(out, "}\n");
+
+    line_index_free(&lines);
+}
+
+static size_t count_nodes(const ASTNode *node) {
+    size_t count = 1;
+    for (size_t i = 0; i < node->child_count; i++) count += count_nodes(node->children[i]);
+    return count;
+}
+
+static void put_u32(unsigned char *p, uint32_t value) {
+    p[0] = (unsigned char)value;
+    p[1] = (unsigned char)(value >> 8);
+    p[2] = (unsigned char)(value >> 16);
+    p[3] = (unsigned char)(value >> 24);
+}
+
+bool ast_export_binary(const ASTNode *root, const char *source, size_t length, FormatBuffer *out) {
+    size_t node_count = count_nodes(root);
+    size_t nodes_offset = sizeof(AstBinaryHeader);
+    size_t source_offset = nodes_offset + node_count * sizeof(AstBinaryNode);
+    size_t total = (source_offset + length + 1 + 3) & ~(size_t)3;
+    if (total > UINT32_MAX) return false;
+
+    format_buffer_reserve(out, total);
+    unsigned char *base = (unsigned char *)out->data + out->length;
+    memset(base, 0, total);
+
+    memcpy(base, AST_BINARY_MAGIC, 4);
+    put_u32(base + offsetof(AstBinaryHeader, version), AST_BINARY_VERSION);
+    put_u32(base + offsetof(AstBinaryHeader, total_size), (uint32_t)total);
+    put_u32(base + offsetof(AstBinaryHeader, node_count), (uint32_t)node_count);
+    put_u32(base + offsetof(AstBinaryHeader, nodes_offset), (uint32_t)nodes_offset);
+    put_u32(base + offsetof(AstBinaryHeader, source_offset), (uint32_t)source_offset);
+    put_u32(base + offsetof(AstBinaryHeader, source_length), (uint32_t)length);
+    memcpy(base + source_offset, source, length);
+
+    // Breadth-first numbering keeps every node's children contiguous.
+    const ASTNode **order = malloc(node_count * sizeof(*order));
+    uint32_t *parents = malloc(node_count * sizeof(*parents));
+    LineIndex lines;
+    line_index_build(&lines, source, length);
+
+    order[0] = root;
+    parents[0] = AST_BINARY_NO_PARENT;
+    size_t next = 1;
+    for (size_t k = 0; k < node_count; k++) {
+        const ASTNode *node = order[k];
+        unsigned char *p = base + nodes_offset + k * sizeof(AstBinaryNode);
+        SourceOffset start, end;
+        int line, column;
+        node_range(node, length, &start, &end);
+        line_index_lookup(&lines, start, &line, &column);
+
+        p[offsetof(AstBinaryNode, node_type)] = (unsigned char)node->type;
+        p[offsetof(AstBinaryNode, token_type)] = is_leaf(node) ? (unsigned char)node->token.type : AST_BINARY_NO_TOKEN;
+        put_u32(p + offsetof(AstBinaryNode, start), (uint32_t)start);
+        put_u32(p + offsetof(AstBinaryNode, end), (uint32_t)end);
+        put_u32(p + offsetof(AstBinaryNode, line), (uint32_t)line);
+        put_u32(p + offsetof(AstBinaryNode, column), (uint32_t)column);
+        put_u32(p + offsetof(AstBinaryNode, parent), parents[k]);
+        put_u32(p + offsetof(AstBinaryNode, first_child), (uint32_t)next);
+        put_u32(p + offsetof(AstBinaryNode, child_count), (uint32_t)node->child_count);
+        put_u32(p + offsetof(AstBinaryNode, leading_newlines), node->leading.newlines);
+        put_u32(p + offsetof(AstBinaryNode, leading_spaces), node->leading.spaces);
+        put_u32(p + offsetof(AstBinaryNode, trailing_newlines), node->trailing.newlines);
+        put_u32(p + offsetof(AstBinaryNode, trailing_spaces), node->trailing.spaces);
+        for (size_t i = 0; i < node->child_count; i++) {
+            parents[next] = (uint32_t)k;
+            order[next++] = node->children[i];
+        }
+    }
+
+    line_index_free(&lines);
+    free(parents);
+    free(order);
+    out->length += total;
+    return true;
+}
+
+static bool host_is_little_endian(void) {
+    const uint32_t one = 1;
+    return *(const unsigned char *)&one == 1;
+}
+
+bool ast_binary_open(const void *data, size_t size, AstBinaryView *view) {
+    // The view reads the fields in place, in host byte order.
+    if (!host_is_little_endian()) return false;
+    const AstBinaryHeader *header = data;
+    if (size < sizeof(*header) || ((uintptr_t)data & 3) != 0) return false;
+    if (memcmp(header->magic, AST_BINARY_MAGIC, 4) != 0 || header->version != AST_BINARY_VERSION) return false;
+    if (header->total_size > size || header->nodes_offset < sizeof(*header) ||
+        (header->nodes_offset & 3) != 0 || header->node_count == 0) {
+        return false;
+    }
+
+    uint64_t nodes_end = header->nodes_offset + (uint64_t)header->node_count * sizeof(AstBinaryNode);
+    if (nodes_end > header->source_offset ||
+        (uint64_t)header->source_offset + header->source_length + 1 > header->total_size) {
+        return false;
+    }
+
+    if (((const char *)data)[header->source_offset + header->source_length] != '\0') return false;
+
+    // Children come after their parent and name it, so walking down from the
+    // root always ends and reaches each node once.
+    const AstBinaryNode *nodes = (const AstBinaryNode *)((const char *)data + header->nodes_offset);
+    for (uint32_t i = 0; i < header->node_count; i++) {
+        const AstBinaryNode *node = &nodes[i];
+        if (node->start > node->end || node->end > header->source_length) return false;
+        if ((uint64_t)node->first_child + node->child_count > header->node_count) return false;
+        if (node->child_count > 0 && node->first_child <= i) return false;
+        for (uint32_t c = 0; c < node->child_count; c++) {
+            if (nodes[node->first_child + c].parent != i) return false;
+        }
+        if (i > 0 && node->parent >= i) return false;
+    }
+
+    view->header = header;
+    view->nodes = nodes;
+    view->source = (const char *)data + header->source_offset;
+    return true;
+}
@@ -0,0 +1,81 @@
+#ifndef AST_EXPORT_H
+#define AST_EXPORT_H
+
+#include "formatter.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Machine-readable dumps of a parse for tools that would otherwise re-lex
+// CMake themselves.
+//
+// JSON: one object per file holding the node tree. Every node has its type,
+// token type, byte range [start, end), 1-based line and byte column, the
+// whitespace before it (see Trivia) and, for leaves, the token text.
+//
+// Binary (little-endian, every field 4-byte aligned so the blob can be used
+// straight from mmap):
+//
+//   AstBinaryHeader
+//   AstBinaryNode[node_count]   breadth-first; the children of a node are
+//                               nodes[first_child .. first_child + child_count)
+//   source bytes + NUL          node ranges are offsets into these bytes
+//
+// total_size covers all three parts, so files can be concatenated and walked
+// by length prefix. Readers must reject versions they do not know.
+
+#define AST_BINARY_MAGIC "CMFA"
+#define AST_BINARY_VERSION 2
+#define AST_BINARY_NO_PARENT UINT32_MAX
+#define AST_BINARY_NO_TOKEN 0xFF // token_type of file and command nodes
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t total_size;
+    uint32_t node_count;
+    uint32_t nodes_offset;
+    uint32_t source_offset;
+    uint32_t source_length;
+    uint32_t reserved;
+} AstBinaryHeader;
+
+typedef struct {
+    uint8_t node_type;  // NodeType
+    uint8_t token_type; // TokenType
+    uint16_t reserved;
+    uint32_t start;
+    uint32_t end;
+    uint32_t line;
+    uint32_t column;
+    uint32_t parent;
+    uint32_t first_child;
+    uint32_t child_count;
+    uint32_t leading_newlines;
+    uint32_t leading_spaces;
+    uint32_t trailing_newlines; // file and command nodes only
+    uint32_t trailing_spaces;
+} AstBinaryNode;
+
+// Points into a binary blob; nothing is copied or allocated.
+typedef struct {
+    const AstBinaryHeader *header;
+    const AstBinaryNode *nodes;
+    const char *source;
+} AstBinaryView;
+
+const char *node_type_name(NodeType type);
+const char *token_type_name(TokenType type);
+
+void ast_export_json(const ASTNode *root, const char *path, const char *source, size_t length,
+                     FormatBuffer *out);
+// Fails if the source does not fit the 32-bit offsets of the format.
+bool ast_export_binary(const ASTNode *root, const char *source, size_t length, FormatBuffer *out);
+// Checks the header, the NUL after the source and every node index of the blob
+// at `data` (which must be 4-byte aligned) and fills in `view`. Each node's
+// children must come after it and name it as their parent, so the tree can be
+// walked from the root without cycles. The view reads the little-endian fields
+// in place, so it is only available on little-endian hosts: elsewhere this
+// always returns false. Also returns false on a malformed blob.
+bool ast_binary_open(const void *data, size_t size, AstBinaryView *view);
+
+#endif
@@ -0,0 +1,474 @@
+#include "batch_io.h"
+#include "trace.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define BATCH_IO_URING 1
+#include <linux/io_uring.h>
+#include <linux/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#ifdef BATCH_IO_URING
+typedef struct {
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_map, *cq_map;
+    size_t sq_map_size, cq_map_size, sqes_size;
+    unsigned queued; // sqes written but not yet submitted
+} Ring;
+#endif
+
+struct BatchIo {
+    size_t syscalls;
+#ifdef BATCH_IO_URING
+    bool allow_uring;
+    bool uring;
+    int ring_fd;
+    Ring ring;
+#endif
+};
+
+// ---------------------------------------------------------------------------
+// Blocking path
+
+static void read_blocking(BatchIo *io, BatchFile *file, size_t max_length) {
+    uint64_t start = trace_now();
+    io->syscalls++;
+    int fd = open(file->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        file->error = errno;
+        return;
+    }
+
+    struct stat st;
+    io->syscalls++;
+    if (fstat(fd, &st) != 0) {
+        file->error = errno;
+    } else if ((uint64_t)st.st_size > max_length) {
+        file->error = EFBIG;
+    } else {
+        size_t size = (size_t)st.st_size, done = 0;
+        char *data = malloc(size + 1);
+        while (done < size) {
+            io->syscalls++;
+            ssize_t n = read(fd, data + done, size - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) file->error = errno;
+            if (n <= 0) break;
+            done += (size_t)n;
+        }
+        if (file->error) {
+            free(data);
+        } else {
+            data[done] = '\0';
+            file->data = data;
+            file->length = done;
+        }
+    }
+    io->syscalls++;
+    close(fd);
+    if (!file->error) trace_span("read", start, file->path, file->length);
+}
+
+static void write_blocking(BatchIo *io, BatchFile *file) {
+    uint64_t start = trace_now();
+    io->syscalls++;
+    int fd = open(file->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0) {
+        file->error = errno;
+        return;
+    }
+    size_t done = 0;
+    while (done < file->length) {
+        io->syscalls++;
+        ssize_t n = write(fd, file->data + done, file->length - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            file->error = n < 0 ? errno : EIO;
+            break;
+        }
+        done += (size_t)n;
+    }
+    io->syscalls++;
+    if (close(fd) != 0 && !file->error) file->error = errno;
+    if (!file->error) trace_span("write", start, file->path, file->length);
+}
+
+// ---------------------------------------------------------------------------
+// io_uring path
+
+#ifdef BATCH_IO_URING
+
+static bool ring_setup(BatchIo *io) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    io->syscalls++;
+    int fd = (int)syscall(__NR_io_uring_setup, 2 * BATCH_IO_DEPTH, &params);
+    if (fd < 0) return false;
+
+    // Opening files by path and statx need 5.6; older kernels reject them.
+    static const int needed[] = { IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_WRITE,
+                                  IORING_OP_CLOSE };
+    size_t probe_size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, probe_size);
+    io->syscalls++;
+    bool supported = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    for (size_t i = 0; supported && i < sizeof(needed) / sizeof(needed[0]); i++) {
+        supported = needed[i] <= probe->last_op && (probe->ops[needed[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    if (!supported) {
+        close(fd);
+        return false;
+    }
+
+    Ring *ring = &io->ring;
+    ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_map = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_map && ring->cq_map_size > ring->sq_map_size) ring->sq_map_size = ring->cq_map_size;
+
+    io->syscalls++;
+    ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                        IORING_OFF_SQ_RING);
+    ring->cq_map = ring->sq_map;
+    if (!single_map && ring->sq_map != MAP_FAILED) {
+        io->syscalls++;
+        ring->cq_map = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                            IORING_OFF_CQ_RING);
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    io->syscalls++;
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                      IORING_OFF_SQES);
+    if (ring->sq_map == MAP_FAILED || ring->cq_map == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        if (ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_size);
+        if (ring->cq_map != MAP_FAILED && ring->cq_map != ring->sq_map) munmap(ring->cq_map, ring->cq_map_size);
+        if (ring->sq_map != MAP_FAILED) munmap(ring->sq_map, ring->sq_map_size);
+        close(fd);
+        return false;
+    }
+
+    char *sq = ring->sq_map, *cq = ring->cq_map;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    ring->queued = 0;
+    io->ring_fd = fd;
+    return true;
+}
+
+static void ring_teardown(BatchIo *io) {
+    Ring *ring = &io->ring;
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_map != ring->sq_map) munmap(ring->cq_map, ring->cq_map_size);
+    munmap(ring->sq_map, ring->sq_map_size);
+    close(io->ring_fd);
+}
+
+// At most two operations per file are ever outstanding, so with
+// 2 * BATCH_IO_DEPTH entries the queue cannot fill up.
+static struct io_uring_sqe *ring_queue(Ring *ring, uint8_t opcode, uint64_t user_data) {
+    unsigned tail = *ring->sq_tail + ring->queued;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->user_data = user_data;
+    ring->sq_array[index] = index;
+    ring->queued++;
+    return sqe;
+}
+
+// Submits what is queued and waits for `wait_for` completions.
+static void ring_enter(BatchIo *io, unsigned wait_for) {
+    Ring *ring = &io->ring;
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + ring->queued, __ATOMIC_RELEASE);
+    unsigned to_submit = ring->queued;
+    ring->queued = 0;
+    for (;;) {
+        io->syscalls++;
+        int submitted = (int)syscall(__NR_io_uring_enter, io->ring_fd, to_submit, wait_for, IORING_ENTER_GETEVENTS,
+                                     NULL, 0);
+        if (submitted >= 0) {
+            to_submit -= (unsigned)submitted;
+            if (to_submit == 0) return;
+        } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            // Operations already in flight still point into our buffers, so
+            // there is no safe way to carry on.
+            perror("io_uring_enter");
+            abort();
+        }
+    }
+}
+
+enum { OP_OPEN, OP_STATX, OP_TRANSFER, OP_CLOSE };
+
+typedef struct {
+    BatchFile *file;
+    uint64_t start;
+    int fd;
+    int waiting;  // completions still expected before the next step
+    size_t size;  // bytes to transfer
+    size_t done;
+    struct statx stat;
+} Slot;
+
+typedef struct {
+    BatchIo *io;
+    bool writing;
+    size_t max_length;
+    Slot slots[BATCH_IO_DEPTH];
+    int free_slots[BATCH_IO_DEPTH];
+    int free_count;
+} Batch;
+
+static uint64_t user_data(int slot, int op) {
+    return (uint64_t)slot << 2 | (uint64_t)op;
+}
+
+static void queue_transfer(Batch *batch, int index) {
+    Slot *slot = &batch->slots[index];
+    uint8_t opcode = batch->writing ? IORING_OP_WRITE : IORING_OP_READ;
+    struct io_uring_sqe *sqe = ring_queue(&batch->io->ring, opcode, user_data(index, OP_TRANSFER));
+    sqe->fd = slot->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(slot->file->data + slot->done);
+    sqe->len = (uint32_t)(slot->size - slot->done > 0x7FFFF000 ? 0x7FFFF000 : slot->size - slot->done);
+    sqe->off = slot->done;
+    slot->waiting = 1;
+}
+
+static void queue_close(Batch *batch, int index) {
+    Slot *slot = &batch->slots[index];
+    struct io_uring_sqe *sqe = ring_queue(&batch->io->ring, IORING_OP_CLOSE, user_data(index, OP_CLOSE));
+    sqe->fd = slot->fd;
+    slot->waiting = 1;
+}
+
+static void start_file(Batch *batch, BatchFile *file) {
+    int index = batch->free_slots[--batch->free_count];
+    Slot *slot = &batch->slots[index];
+    slot->file = file;
+    slot->start = trace_now();
+    slot->fd = -1;
+    slot->done = 0;
+    slot->size = batch->writing ? file->length : 0;
+
+    struct io_uring_sqe *sqe = ring_queue(&batch->io->ring, IORING_OP_OPENAT, user_data(index, OP_OPEN));
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uint64_t)(uintptr_t)file->path;
+    if (batch->writing) {
+        sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        sqe->len = 0666;
+        slot->waiting = 1;
+        return;
+    }
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+
+    // The size comes from a statx on the path issued alongside the open.
+    sqe = ring_queue(&batch->io->ring, IORING_OP_STATX, user_data(index, OP_STATX));
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uint64_t)(uintptr_t)file->path;
+    sqe->len = STATX_SIZE;
+    sqe->off = (uint64_t)(uintptr_t)&slot->stat;
+    slot->waiting = 2;
+}
+
+static void finish_file(Batch *batch, int index) {
+    Slot *slot = &batch->slots[index];
+    BatchFile *file = slot->file;
+    if (!batch->writing) {
+        if (file->error) {
+            free(file->data);
+            file->data = NULL;
+        } else {
+            file->data[slot->done] = '\0';
+            file->length = slot->done;
+        }
+    }
+    if (!file->error) trace_span(batch->writing ? "write" : "read", slot->start, file->path, slot->done);
+    batch->free_slots[batch->free_count++] = index;
+}
+
+// The file is open (or failed to open) and, for reads, its size is known.
+static void after_open(Batch *batch, int index) {
+    Slot *slot = &batch->slots[index];
+    BatchFile *file = slot->file;
+    if (!file->error && !batch->writing) {
+        if (slot->stat.stx_size > batch->max_length) {
+            file->error = EFBIG;
+        } else {
+            slot->size = (size_t)slot->stat.stx_size;
+            file->data = malloc(slot->size + 1);
+        }
+    }
+    if (slot->fd < 0) {
+        finish_file(batch, index);
+    } else if (!file->error && slot->size > 0) {
+        queue_transfer(batch, index);
+    } else {
+        queue_close(batch, index);
+    }
+}
+
+static void complete(Batch *batch, uint64_t data, int result) {
+    int index = (int)(data >> 2);
+    Slot *slot = &batch->slots[index];
+    BatchFile *file = slot->file;
+    slot->waiting--;
+
+    switch ((int)(data & 3)) {
+    case OP_OPEN:
+        if (result < 0) {
+            file->error = -result;
+        } else {
+            slot->fd = result;
+        }
+        if (slot->waiting == 0) after_open(batch, index);
+        break;
+    case OP_STATX:
+        if (result < 0 && !file->error) file->error = -result;
+        if (slot->waiting == 0) after_open(batch, index);
+        break;
+    case OP_TRANSFER:
+        if (result == -EINTR || result == -EAGAIN) {
+            queue_transfer(batch, index);
+            break;
+        }
+        if (result < 0) {
+            file->error = -result;
+        } else if (result == 0 && batch->writing) {
+            file->error = EIO;
+        } else if (result > 0) {
+            slot->done += (size_t)result;
+            if (slot->done < slot->size) {
+                queue_transfer(batch, index);
+                break;
+            }
+        }
+        // A read of 0 means the file shrank since the statx; keep what we got.
+        queue_close(batch, index);
+        break;
+    case OP_CLOSE:
+        if (result < 0 && !file->error) file->error = -result;
+        finish_file(batch, index);
+        break;
+    }
+}
+
+static void run_uring(BatchIo *io, BatchFile *files, size_t count, bool writing, size_t max_length) {
+    Batch *batch = malloc(sizeof(Batch));
+    batch->io = io;
+    batch->writing = writing;
+    batch->max_length = max_length;
+    batch->free_count = BATCH_IO_DEPTH;
+    for (int i = 0; i < BATCH_IO_DEPTH; i++) batch->free_slots[i] = BATCH_IO_DEPTH - 1 - i;
+
+    Ring *ring = &io->ring;
+    size_t next = 0;
+    while (next < count || batch->free_count < BATCH_IO_DEPTH) {
+        while (next < count && batch->free_count > 0) start_file(batch, &files[next++]);
+        // Every file in flight has an operation outstanding. Waiting for half
+        // of them keeps the queue busy while taking completions in bulk.
+        unsigned in_flight = (unsigned)(BATCH_IO_DEPTH - batch->free_count);
+        ring_enter(io, in_flight > 1 ? in_flight / 2 : 1);
+
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            complete(batch, cqe->user_data, cqe->res);
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+    free(batch);
+}
+
+// The ring is set up on first use, so that runs touching a single file never
+// pay for it.
+static bool use_uring(BatchIo *io, size_t count) {
+    if (io->allow_uring && count > 1) {
+        io->allow_uring = false;
+        io->uring = ring_setup(io);
+    }
+    return io->uring;
+}
+
+#endif
+
+// ---------------------------------------------------------------------------
+
+BatchIo *batch_io_open(bool allow_uring) {
+    BatchIo *io = calloc(1, sizeof(BatchIo));
+#ifdef BATCH_IO_URING
+    io->allow_uring = allow_uring;
+#else
+    (void)allow_uring;
+#endif
+    return io;
+}
+
+void batch_io_close(BatchIo *io) {
+    if (!io) return;
+#ifdef BATCH_IO_URING
+    if (io->uring) ring_teardown(io);
+#endif
+    free(io);
+}
+
+bool batch_io_uses_uring(BatchIo *io) {
+#ifdef BATCH_IO_URING
+    return use_uring(io, 2);
+#else
+    (void)io;
+    return false;
+#endif
+}
+
+size_t batch_io_syscalls(const BatchIo *io) {
+    return io->syscalls;
+}
+
+void batch_io_read(BatchIo *io, BatchFile *files, size_t count, size_t max_length) {
+    for (size_t i = 0; i < count; i++) {
+        files[i].data = NULL;
+        files[i].length = 0;
+        files[i].error = 0;
+    }
+#ifdef BATCH_IO_URING
+    if (use_uring(io, count)) {
+        run_uring(io, files, count, false, max_length);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; i++) read_blocking(io, &files[i], max_length);
+}
+
+void batch_io_write(BatchIo *io, BatchFile *files, size_t count) {
+    for (size_t i = 0; i < count; i++) files[i].error = 0;
+#ifdef BATCH_IO_URING
+    if (use_uring(io, count)) {
+        run_uring(io, files, count, true, 0);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; i++) write_blocking(io, &files[i]);
+}
@@ -0,0 +1,41 @@
+#ifndef BATCH_IO_H
+#define BATCH_IO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Whole-file reads and writes for many files at once. On Linux the opens,
+// statx calls, reads, writes and closes of up to BATCH_IO_DEPTH files are kept
+// in flight together on an io_uring, so a batch costs a handful of system
+// calls instead of several per file. Where io_uring is missing, disabled or
+// lacks those operations, each file goes through open/fstat/read/close.
+
+#define BATCH_IO_DEPTH 64
+
+typedef struct {
+    const char *path;
+    char *data;    // read: malloc'd and NUL-terminated, NULL on failure; write: the content
+    size_t length;
+    int error;     // errno of the step that failed, 0 on success
+} BatchFile;
+
+typedef struct BatchIo BatchIo;
+
+// With `allow_uring` false the blocking path is always used. Otherwise the
+// ring is set up by the first batch of more than one file, so a run that only
+// ever touches single files never pays for it.
+BatchIo *batch_io_open(bool allow_uring);
+void batch_io_close(BatchIo *io);
+// Sets up the ring if it is not yet, and reports whether it is in use.
+bool batch_io_uses_uring(BatchIo *io);
+// System calls issued so far.
+size_t batch_io_syscalls(const BatchIo *io);
+
+// Fills in data, length and error for each file. Files longer than
+// `max_length` fail with EFBIG.
+void batch_io_read(BatchIo *io, BatchFile *files, size_t count, size_t max_length);
+// Replaces the content of each file with data[0, length), creating it if
+// needed, and sets error.
+void batch_io_write(BatchIo *io, BatchFile *files, size_t count);
+
+#endif
@@ -0,0 +1,140 @@
+// Reads and rewrites a tree of small CMake files with the blocking and the
+// io_uring backends of batch_io, reporting wall time and system calls per
+// file. Caches are warm unless dropped between runs (as root:
+// `sync; echo 3 > /proc/sys/vm/drop_caches`); pass an existing directory on
+// the mount under test to measure it instead of /tmp.
+// Usage: bench_io [files] [directory]
+#include "../batch_io.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FILES_PER_DIR 100
+
+static const char *snippet =
+    "# Generated module %d\n"
+    "option(ENABLE_MODULE_%d \"Enable module %d\" OFF)\n"
+    "if(ENABLE_MODULE_%d)\n"
+    "  add_library(module_%d STATIC src/a_%d.c src/b_%d.c)\n"
+    "  target_link_libraries(module_%d PUBLIC core)\n"
+    "endif()\n";
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    double read_ms;
+    double write_ms;
+    size_t read_syscalls;
+    size_t write_syscalls;
+    size_t bytes;
+    unsigned long checksum;
+} Run;
+
+static bool run_backend(bool uring, BatchFile *files, size_t count, Run *run) {
+    BatchIo *io = batch_io_open(uring);
+    if (uring && !batch_io_uses_uring(io)) {
+        batch_io_close(io);
+        return false;
+    }
+
+    size_t base = batch_io_syscalls(io);
+    double t0 = now_seconds();
+    batch_io_read(io, files, count, (size_t)-1);
+    run->read_ms = (now_seconds() - t0) * 1000;
+    run->read_syscalls = batch_io_syscalls(io) - base;
+
+    run->bytes = 0;
+    run->checksum = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!files[i].data) {
+            fprintf(stderr, "%s: %s\n", files[i].path, strerror(files[i].error));
+            exit(1);
+        }
+        run->bytes += files[i].length;
+        for (size_t k = 0; k < files[i].length; k++) run->checksum = run->checksum * 31 + (unsigned char)files[i].data[k];
+    }
+
+    base = batch_io_syscalls(io);
+    t0 = now_seconds();
+    batch_io_write(io, files, count);
+    run->write_ms = (now_seconds() - t0) * 1000;
+    run->write_syscalls = batch_io_syscalls(io) - base;
+
+    for (size_t i = 0; i < count; i++) free(files[i].data);
+    batch_io_close(io);
+    return true;
+}
+
+static void print_run(const char *label, const Run *run, size_t count) {
+    printf("%-10s %10.2f %12.2f %10.2f %12.2f\n", label, run->read_ms, (double)run->read_syscalls / count,
+           run->write_ms, (double)run->write_syscalls / count);
+}
+
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? (size_t)atol(argv[1]) : 10000;
+    char root[PATH_MAX];
+    int written = snprintf(root, sizeof(root), "%s/bench_io.XXXXXX", argc > 2 ? argv[2] : "/tmp");
+    if (written < 0 || (size_t)written >= sizeof(root)) {
+        fprintf(stderr, "%s: path too long\n", argv[2]);
+        return 1;
+    }
+    if (!mkdtemp(root)) {
+        perror(root);
+        return 1;
+    }
+
+    BatchFile *files = calloc(count, sizeof(BatchFile));
+    char **paths = calloc(count, sizeof(char *));
+    char text[1024];
+    char dir[PATH_MAX + 32]; // root and "/d<index>"
+    for (size_t i = 0; i < count; i++) {
+        snprintf(dir, sizeof(dir), "%s/d%zu", root, i / FILES_PER_DIR);
+        if (i % FILES_PER_DIR == 0) mkdir(dir, 0777);
+        paths[i] = malloc(strlen(dir) + 32);
+        sprintf(paths[i], "%s/CMakeLists%zu.txt", dir, i % FILES_PER_DIR);
+        int n = (int)i;
+        int length = snprintf(text, sizeof(text), snippet, n, n, n, n, n, n, n, n);
+        FILE *f = fopen(paths[i], "wb");
+        fwrite(text, 1, (size_t)length, f);
+        fclose(f);
+        files[i].path = paths[i];
+    }
+
+    printf("%zu files under %s\n", count, root);
+    printf("%-10s %10s %12s %10s %12s\n", "backend", "read (ms)", "calls/file", "write (ms)", "calls/file");
+
+    int status = 0;
+    Run blocking, uring;
+    run_backend(false, files, count, &blocking);
+    print_run("blocking", &blocking, count);
+    if (run_backend(true, files, count, &uring)) {
+        print_run("io_uring", &uring, count);
+        if (uring.bytes != blocking.bytes || uring.checksum != blocking.checksum) {
+            fprintf(stderr, "io_uring read different content\n");
+            status = 1;
+        }
+    } else {
+        printf("%-10s unavailable\n", "io_uring");
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        unlink(paths[i]);
+        free(paths[i]);
+    }
+    for (size_t d = 0; d * FILES_PER_DIR < count; d++) {
+        snprintf(dir, sizeof(dir), "%s/d%zu", root, d);
+        rmdir(dir);
+    }
+    rmdir(root);
+    free(paths);
+    free(files);
+    return status;
+}
@@ -0,0 +1,82 @@
+// Formatting time of the config-specialized kernel against the generic one
+// on a large generated file, with the default config.
+// Usage: bench_kernels [megabytes]
+#include "../parser.h"
+#include "../config.h"
+#include "../formatter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *snippet =
+    "# Generated target %d\n"
+    "option(ENABLE_FEATURE_%d \"Enable feature %d\" OFF)\n"
+    "if(ENABLE_FEATURE_%d)\n"
+    "  add_library(feature_%d STATIC src/a_%d.c\n"
+    "    src/b_%d.c src/c_%d.c)\n"
+    "  target_link_libraries(feature_%d PUBLIC core PRIVATE m)\n"
+    "  install(TARGETS feature_%d DESTINATION lib COMPONENT runtime)\n"
+    "else()\n"
+    "  set(FEATURE_%d_SOURCES \"\" CACHE STRING \"unused\")\n"
+    "endif()\n"
+    "\n";
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Best of several runs, in seconds.
+static double measure(ASTNode *ast, const FormatBuffer *source, const CMakeFormatConfig *config,
+                      FormatBuffer *out) {
+    double best = 1e30;
+    for (int run = 0; run < 7; run++) {
+        out->length = 0;
+        double t0 = now_seconds();
+        format_ast_to_buffer(ast, source->data, config, out);
+        double elapsed = now_seconds() - t0;
+        if (elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    size_t target = (size_t)(argc > 1 ? atof(argv[1]) : 16.0) * 1024 * 1024;
+
+    FormatBuffer source = {0};
+    char block[2048];
+    for (int n = 0; source.length < target; n++) {
+        int len = snprintf(block, sizeof(block), snippet, n, n, n, n, n, n, n, n, n, n, n);
+        format_buffer_reserve(&source, (size_t)len + 1);
+        memcpy(source.data + source.length, block, (size_t)len);
+        source.length += (size_t)len;
+    }
+    source.data[source.length] = '\0';
+
+    CMakeFormatConfig config;
+    config_init_defaults(&config);
+    ASTNode *ast = parse_cmake(source.data);
+
+    FormatBuffer generic = {0}, specialized = {0};
+    formatter_force_generic = true;
+    double generic_time = measure(ast, &source, &config, &generic);
+    formatter_force_generic = false;
+    double specialized_time = measure(ast, &source, &config, &specialized);
+
+    bool identical = generic.length == specialized.length &&
+                     memcmp(generic.data, specialized.data, generic.length) == 0;
+    printf("input: %.1f MiB\n", source.length / 1048576.0);
+    printf("%-12s %10.2f ms %8.1f MiB/s\n", "generic", generic_time * 1000,
+           source.length / 1048576.0 / generic_time);
+    printf("%-12s %10.2f ms %8.1f MiB/s  (%s kernel, %.2fx, output %s)\n", "specialized",
+           specialized_time * 1000, source.length / 1048576.0 / specialized_time, formatter_kernel_name(&config),
+           generic_time / specialized_time, identical ? "identical" : "DIFFERENT");
+
+    format_buffer_free(&generic);
+    format_buffer_free(&specialized);
+    free_ast(ast);
+    format_buffer_free(&source);
+    return identical ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+// Scaling benchmark for format_ast_parallel on a large generated file.
+// Usage: bench_parallel [megabytes]
+#include "../parser.h"
+#include "../config.h"
+#include "../formatter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *snippet =
+    "# Generated target %d\n"
+    "option(ENABLE_FEATURE_%d \"Enable feature %d\" OFF)\n"
+    "option(USE_BACKEND_%d   \"Use backend\"   ON)\n"
+    "\n"
+    "if(ENABLE_FEATURE_%d)\n"
+    "  add_library(feature_%d STATIC src/a_%d.c\n"
+    "    src/b_%d.c src/c_%d.c)\n"
+    "  target_link_libraries(feature_%d PUBLIC core PRIVATE m)\n"
+    "  foreach(dep IN LISTS FEATURE_DEPS)\n"
+    "      message(STATUS \"dep ${dep}\")\n"
+    "  endforeach()\n"
+    "else()\n"
+    "  set(FEATURE_%d_SOURCES \"\" CACHE STRING \"unused\")\n"
+    "endif()\n"
+    "\n";
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    size_t target = (size_t)(argc > 1 ? atof(argv[1]) : 16.0) * 1024 * 1024;
+
+    FormatBuffer source = {0};
+    char block[2048];
+    for (int n = 0; source.length < target; n++) {
+        int len = snprintf(block, sizeof(block), snippet, n, n, n, n, n, n, n, n, n, n, n);
+        format_buffer_reserve(&source, (size_t)len + 1);
+        memcpy(source.data + source.length, block, (size_t)len);
+        source.length += (size_t)len;
+    }
+    source.data[source.length] = '\0';
+
+    CMakeFormatConfig config;
+    config_init_defaults(&config);
+    config.AlignOptions = true;
+
+    ASTNode *ast = parse_cmake(source.data);
+
+    FormatBuffer expected = {0};
+    double t0 = now_seconds();
+    format_ast_to_buffer(ast, source.data, &config, &expected);
+    double sequential = now_seconds() - t0;
+
+    printf("input: %.1f MiB, %zu top-level nodes\n", source.length / 1048576.0, ast->child_count);
+    printf("%8s %12s %10s %s\n", "threads", "time (ms)", "speedup", "identical");
+    printf("%8s %12.2f %10.2f %s\n", "seq", sequential * 1000, 1.0, "-");
+
+    int failures = 0;
+    for (int threads = 1; threads <= 32; threads *= 2) {
+        double best = 1e9;
+        bool identical = true;
+        for (int rep = 0; rep < 3; rep++) {
+            FormatBuffer out = {0};
+            t0 = now_seconds();
+            format_ast_parallel(ast, source.data, &config, &out, threads);
+            double elapsed = now_seconds() - t0;
+            if (elapsed < best) best = elapsed;
+            identical = identical && out.length == expected.length &&
+                        memcmp(out.data, expected.data, out.length) == 0;
+            format_buffer_free(&out);
+        }
+        if (!identical) failures++;
+        printf("%8d %12.2f %10.2f %s\n", threads, best * 1000, sequential / best, identical ? "yes" : "NO");
+    }
+
+    format_buffer_free(&expected);
+    free_ast(ast);
+    format_buffer_free(&source);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,81 @@
+// Parsing throughput of parse_cmake on ordinary and deeply nested input.
+// Usage: bench_parse [megabytes]
+#include "../parser.h"
+#include "../formatter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *snippet =
+    "# Generated target %d\n"
+    "option(ENABLE_FEATURE_%d \"Enable feature %d\" OFF)\n"
+    "if((ENABLE_FEATURE_%d AND (NOT WIN32 OR MINGW)) OR FORCE_%d)\n"
+    "  add_library(feature_%d STATIC src/a_%d.c\n"
+    "    src/b_%d.c src/c_%d.c)\n"
+    "  target_compile_definitions(feature_%d PRIVATE $<$<CONFIG:Debug>:DEBUG=1>)\n"
+    "  set(FEATURE_%d_SOURCES \"\" CACHE STRING \"unused\")\n"
+    "endif()\n"
+    "\n";
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void append(FormatBuffer *buffer, const char *text, size_t length) {
+    format_buffer_reserve(buffer, length + 1);
+    memcpy(buffer->data + buffer->length, text, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+}
+
+// Best of several runs, in MiB/s.
+static double measure(const char *label, const FormatBuffer *source) {
+    double best = 1e30;
+    size_t nodes = 0;
+    for (int run = 0; run < 5; run++) {
+        double t0 = now_seconds();
+        ASTNode *ast = parse_cmake(source->data);
+        double elapsed = now_seconds() - t0;
+        if (elapsed < best) best = elapsed;
+        nodes = ast->child_count;
+        free_ast(ast);
+    }
+    double rate = source->length / 1048576.0 / best;
+    printf("%-10s %8.1f MiB %10zu nodes %10.2f ms %10.1f MiB/s\n", label, source->length / 1048576.0, nodes,
+           best * 1000, rate);
+    return rate;
+}
+
+int main(int argc, char **argv) {
+    size_t target = (size_t)(argc > 1 ? atof(argv[1]) : 16.0) * 1024 * 1024;
+
+    FormatBuffer normal = {0};
+    char block[2048];
+    for (int n = 0; normal.length < target; n++) {
+        int len = snprintf(block, sizeof(block), snippet, n, n, n, n, n, n, n, n, n, n, n);
+        append(&normal, block, (size_t)len);
+    }
+
+    // One condition nested as deep as the size allows; a recursive parser
+    // would need a stack frame per level.
+    FormatBuffer nested = {0};
+    size_t depth = target / 2 - 16;
+    append(&nested, "if", 2);
+    format_buffer_reserve(&nested, 2 * depth + 16);
+    memset(nested.data + nested.length, '(', depth);
+    nested.length += depth;
+    append(&nested, "x", 1);
+    memset(nested.data + nested.length, ')', depth);
+    nested.length += depth;
+    append(&nested, "\n", 1);
+
+    measure("normal", &normal);
+    measure("nested", &nested);
+
+    format_buffer_free(&normal);
+    format_buffer_free(&nested);
+    return 0;
+}
@@ -17,6 +17,10 @@ void config_init_defaults(CMakeFormatConfig *config) {
     config->AlwaysBreakAfterFirstArgument = false;
     config->BreakBeforeKeywordArgument = false;
     config->AlignOptions = false;
+    config->AlignConsecutiveSet = false;
+    config->AlignConsecutiveSetProperty = false;
+    config->AlignConsecutiveFindPackage = false;
+    config->CommandKeywords[0] = '\0';
 }
 
 static char *trim_whitespace(char *str) {
@@ -34,81 +38,218 @@ static bool parse_bool(const char *val) {
     return false;
 }
 
+// Skips one packed CommandKeywords entry.
+static const char *next_command_keywords(const char *entry) {
+    entry += strlen(entry) + 1;
+    while (*entry) entry += strlen(entry) + 1;
+    return entry + 1;
+}
+
+static bool append_word(char *pool, size_t *at, const char *word, size_t length) {
+    // Leave room for the empty name that ends the pool.
+    if (*at + length + 1 >= CONFIG_COMMAND_KEYWORDS_SIZE) return false;
+    memcpy(pool + *at, word, length);
+    pool[*at + length] = '\0';
+    *at += length + 1;
+    return true;
+}
+
+// Adds one "name: [KEYWORD, ...]" line of the CommandKeywords block. Entries
+// that do not fit are dropped whole.
+static void add_command_keywords(CMakeFormatConfig *config, char *line) {
+    char *colon = strchr(line, ':');
+    if (!colon) return;
+    *colon = '\0';
+    char *name = trim_whitespace(line);
+    if (*name == '\0') return;
+
+    char *pool = config->CommandKeywords;
+    size_t start = 0;
+    while (pool[start]) start = (size_t)(next_command_keywords(pool + start) - pool);
+    size_t at = start;
+    bool fits = append_word(pool, &at, name, strlen(name));
+
+    const char *separators = " \t,[]";
+    for (char *p = colon + 1; fits && *p;) {
+        p += strspn(p, separators);
+        size_t length = strcspn(p, separators);
+        if (length == 0) break;
+        fits = append_word(pool, &at, p, length);
+        p += length;
+    }
+    fits = fits && at + 1 < CONFIG_COMMAND_KEYWORDS_SIZE;
+    if (fits) {
+        pool[at] = '\0';
+        pool[at + 1] = '\0';
+    } else {
+        pool[start] = '\0';
+    }
+}
+
+const char *config_command_keywords(const CMakeFormatConfig *config, const char *name, size_t length) {
+    for (const char *entry = config->CommandKeywords; *entry; entry = next_command_keywords(entry)) {
+        if (strlen(entry) == length && strncasecmp(entry, name, length) == 0) return entry + length + 1;
+    }
+    return NULL;
+}
+
+// Applies one line of a .cmake_format. `line` is modified.
+static void parse_config_line(CMakeFormatConfig *config, char *line, bool *in_command_keywords) {
+    // CommandKeywords is the one block mapping; its entries are indented.
+    bool indented = line[0] == ' ' || line[0] == '\t';
+    char *trimmed = trim_whitespace(line);
+    if (*in_command_keywords && indented && trimmed[0] != '#' && trimmed[0] != '\0') {
+        add_command_keywords(config, trimmed);
+        return;
+    }
+    if (!indented && trimmed[0] != '\0' && trimmed[0] != '#') *in_command_keywords = false;
+    if (trimmed[0] == '#' || trimmed[0] == '\0') return; // comment or empty block
+    if (strncmp(trimmed, "---", 3) == 0 || strncmp(trimmed, "...", 3) == 0) return; // YAML document boundaries
+
+    char *colon = strchr(trimmed, ':');
+    if (!colon) return;
+
+    *colon = '\0';
+    char *key = trim_whitespace(trimmed);
+    char *val = trim_whitespace(colon + 1);
+
+    if (strcmp(key, "IndentWidth") == 0) {
+        config->IndentWidth = atoi(val);
+    } else if (strcmp(key, "ColumnLimit") == 0) {
+        config->ColumnLimit = atoi(val);
+    } else if (strcmp(key, "UseTab") == 0) {
+        // Can be Never, Always, etc in clang-format, but let's do a simple check
+        if (strcasecmp(val, "Always") == 0 || strcasecmp(val, "true") == 0) {
+            config->UseTab = true;
+        } else {
+            config->UseTab = false;
+        }
+    } else if (strcmp(key, "SpacesInParens") == 0) {
+        if (strcasecmp(val, "Never") == 0 || strcasecmp(val, "false") == 0) {
+            config->SpacesInParens = false;
+        } else {
+            config->SpacesInParens = true;
+        }
+    } else if (strcmp(key, "SpaceBeforeParens") == 0) {
+        if (strcasecmp(val, "Never") == 0 || strcasecmp(val, "false") == 0) {
+            config->SpaceBeforeParens = false;
+        } else {
+            config->SpaceBeforeParens = true;
+        }
+    } else if (strcmp(key, "AlignArguments") == 0) { // Using a custom key roughly matching AlignOperands
+        config->AlignArguments = parse_bool(val);
+    } else if (strcmp(key, "AlignOperands") == 0) {
+        if (strcasecmp(val, "DontAlign") == 0) config->AlignArguments = false;
+        else config->AlignArguments = true;
+    } else if (strcmp(key, "ClosingParensOnNewLine") == 0) {
+        config->ClosingParensOnNewLine = parse_bool(val);
+    } else if (strcmp(key, "AlwaysBreakAfterFirstArgument") == 0) {
+        config->AlwaysBreakAfterFirstArgument = parse_bool(val);
+    } else if (strcmp(key, "KeepShortStatementOnSameLine") == 0) {
+        config->KeepShortStatementOnSameLine = atoi(val);
+    } else if (strcmp(key, "BreakBeforeKeywordArgument") == 0) {
+        config->BreakBeforeKeywordArgument = parse_bool(val);
+    } else if (strcmp(key, "AlignOptions") == 0) {
+        config->AlignOptions = parse_bool(val);
+    } else if (strcmp(key, "AlignConsecutiveSet") == 0) {
+        config->AlignConsecutiveSet = parse_bool(val);
+    } else if (strcmp(key, "AlignConsecutiveSetProperty") == 0) {
+        config->AlignConsecutiveSetProperty = parse_bool(val);
+    } else if (strcmp(key, "AlignConsecutiveFindPackage") == 0) {
+        config->AlignConsecutiveFindPackage = parse_bool(val);
+    } else if (strcmp(key, "CommandKeywords") == 0) {
+        *in_command_keywords = true;
+    }
+}
+
 bool config_load_from_file(CMakeFormatConfig *config, const char *filepath) {
     FILE *f = fopen(filepath, "r");
     if (!f) return false;
 
     char line[1024];
-    while (fgets(line, sizeof(line), f)) {
-        char *trimmed = trim_whitespace(line);
-        if (trimmed[0] == '#' || trimmed[0] == '\0') continue; // comment or empty block
-        if (strncmp(trimmed, "---", 3) == 0 || strncmp(trimmed, "...", 3) == 0) continue; // YAML document boundaries
-
-        char *colon = strchr(trimmed, ':');
-        if (!colon) continue;
-
-        *colon = '\0';
-        char *key = trim_whitespace(trimmed);
-        char *val = trim_whitespace(colon + 1);
-
-        if (strcmp(key, "IndentWidth") == 0) {
-            config->IndentWidth = atoi(val);
-        } else if (strcmp(key, "ColumnLimit") == 0) {
-            config->ColumnLimit = atoi(val);
-        } else if (strcmp(key, "UseTab") == 0) {
-            // Can be Never, Always, etc in clang-format, but let's do a simple check
-            if (strcasecmp(val, "Always") == 0 || strcasecmp(val, "true") == 0) {
-                config->UseTab = true;
-            } else {
-                config->UseTab = false;
-            }
-        } else if (strcmp(key, "SpacesInParens") == 0) {
-            if (strcasecmp(val, "Never") == 0 || strcasecmp(val, "false") == 0) {
-                config->SpacesInParens = false;
-            } else {
-                config->SpacesInParens = true;
-            }
-        } else if (strcmp(key, "SpaceBeforeParens") == 0) {
-            if (strcasecmp(val, "Never") == 0 || strcasecmp(val, "false") == 0) {
-                config->SpaceBeforeParens = false;
-            } else {
-                config->SpaceBeforeParens = true;
+    bool in_command_keywords = false;
+    while (fgets(line, sizeof(line), f)) parse_config_line(config, line, &in_command_keywords);
+
+    fclose(f);
+    return true;
+}
+
+void config_load_from_string(CMakeFormatConfig *config, const char *text) {
+    char line[1024];
+    bool in_command_keywords = false;
+    while (*text) {
+        // Split like fgets: at newlines and after sizeof(line) - 1 bytes.
+        size_t length = 0;
+        while (text[length] && length < sizeof(line) - 1 && (length == 0 || text[length - 1] != '\n')) length++;
+        memcpy(line, text, length);
+        line[length] = '\0';
+        text += length;
+        parse_config_line(config, line, &in_command_keywords);
+    }
+}
+
+static void write_text(ConfigWriter write, void *context, const char *text) {
+    write(text, strlen(text), context);
+}
+
+static void write_bool(ConfigWriter write, void *context, const char *key, bool value) {
+    write_text(write, context, key);
+    write_text(write, context, value ? ": true\n" : ": false\n");
+}
+
+// Without printf, so that the WebAssembly build need not link it.
+static void write_int(ConfigWriter write, void *context, const char *key, int value) {
+    char digits[16];
+    size_t at = sizeof(digits);
+    unsigned magnitude = value < 0 ? 0u - (unsigned)value : (unsigned)value;
+    do {
+        digits[--at] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0) digits[--at] = '-';
+    write_text(write, context, key);
+    write_text(write, context, ": ");
+    write(digits + at, sizeof(digits) - at, context);
+    write_text(write, context, "\n");
+}
+
+void config_write(const CMakeFormatConfig *config, ConfigWriter write, void *context) {
+    write_text(write, context, "---\n");
+    write_int(write, context, "IndentWidth", config->IndentWidth);
+    write_int(write, context, "ColumnLimit", config->ColumnLimit);
+    write_bool(write, context, "UseTab", config->UseTab);
+    write_bool(write, context, "SpacesInParens", config->SpacesInParens);
+    write_bool(write, context, "SpaceBeforeParens", config->SpaceBeforeParens);
+    write_bool(write, context, "AlignArguments", config->AlignArguments);
+    write_bool(write, context, "ClosingParensOnNewLine", config->ClosingParensOnNewLine);
+    write_bool(write, context, "AlwaysBreakAfterFirstArgument", config->AlwaysBreakAfterFirstArgument);
+    write_bool(write, context, "BreakBeforeKeywordArgument", config->BreakBeforeKeywordArgument);
+    write_bool(write, context, "AlignOptions", config->AlignOptions);
+    write_bool(write, context, "AlignConsecutiveSet", config->AlignConsecutiveSet);
+    write_bool(write, context, "AlignConsecutiveSetProperty", config->AlignConsecutiveSetProperty);
+    write_bool(write, context, "AlignConsecutiveFindPackage", config->AlignConsecutiveFindPackage);
+    write_int(write, context, "KeepShortStatementOnSameLine", config->KeepShortStatementOnSameLine);
+    if (config->CommandKeywords[0]) {
+        write_text(write, context, "CommandKeywords:\n");
+        for (const char *entry = config->CommandKeywords; *entry; entry = next_command_keywords(entry)) {
+            write_text(write, context, "  ");
+            write_text(write, context, entry);
+            write_text(write, context, ": [");
+            const char *word = entry + strlen(entry) + 1;
+            for (bool first = true; *word; word += strlen(word) + 1, first = false) {
+                if (!first) write_text(write, context, ", ");
+                write_text(write, context, word);
             }
-        } else if (strcmp(key, "AlignArguments") == 0) { // Using a custom key roughly matching AlignOperands
-            config->AlignArguments = parse_bool(val);
-        } else if (strcmp(key, "AlignOperands") == 0) {
-            if (strcasecmp(val, "DontAlign") == 0) config->AlignArguments = false;
-            else config->AlignArguments = true;
-        } else if (strcmp(key, "ClosingParensOnNewLine") == 0) {
-            config->ClosingParensOnNewLine = parse_bool(val);
-        } else if (strcmp(key, "AlwaysBreakAfterFirstArgument") == 0) {
-            config->AlwaysBreakAfterFirstArgument = parse_bool(val);
-        } else if (strcmp(key, "KeepShortStatementOnSameLine") == 0) {
-            config->KeepShortStatementOnSameLine = atoi(val);
-        } else if (strcmp(key, "BreakBeforeKeywordArgument") == 0) {
-            config->BreakBeforeKeywordArgument = parse_bool(val);
-        } else if (strcmp(key, "AlignOptions") == 0) {
-            config->AlignOptions = parse_bool(val);
+            write_text(write, context, "]\n");
         }
     }
+    write_text(write, context, "...\n");
+}
 
-
-    fclose(f);
-    return true;
+static void write_to_file(const char *text, size_t length, void *context) {
+    fwrite(text, 1, length, context);
 }
 
 void config_dump(const CMakeFormatConfig *config, FILE *out) {
-    fprintf(out, "---\n");
-    fprintf(out, "AlignArguments: %s\n", config->AlignArguments ? "true" : "false");
-    fprintf(out, "AlignOptions: %s\n", config->AlignOptions ? "true" : "false");
-    fprintf(out, "AlwaysBreakAfterFirstArgument: %s\n", config->AlwaysBreakAfterFirstArgument ? "true" : "false");
-    fprintf(out, "BreakBeforeKeywordArgument: %s\n", config->BreakBeforeKeywordArgument ? "true" : "false");
-    fprintf(out, "ClosingParensOnNewLine: %s\n", config->ClosingParensOnNewLine ? "true" : "false");
-    fprintf(out, "ColumnLimit: %d\n", config->ColumnLimit);
-    fprintf(out, "IndentWidth: %d\n", config->IndentWidth);
-    fprintf(out, "KeepShortStatementOnSameLine: %d\n", config->KeepShortStatementOnSameLine);
-    fprintf(out, "SpaceBeforeParens: %s\n", config->SpaceBeforeParens ? "true" : "false");
-    fprintf(out, "SpacesInParens: %s\n", config->SpacesInParens ? "true" : "false");
-    fprintf(out, "UseTab: %s\n", config->UseTab ? "true" : "false");
-    fprintf(out, "...\n");
+    config_write(config, write_to_file, out);
 }
@@ -2,8 +2,11 @@
 #define CONFIG_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 
+#define CONFIG_COMMAND_KEYWORDS_SIZE 4096
+
 // Some basic ClangFormat-like keys we might want to support
 typedef struct {
     int IndentWidth;
@@ -17,10 +20,28 @@ typedef struct {
     bool AlwaysBreakAfterFirstArgument;
     bool BreakBeforeKeywordArgument;
     bool AlignOptions;
+    // Align the leading arguments of runs of set(), set_property() and
+    // find_package() calls, as AlignOptions does for option().
+    bool AlignConsecutiveSet;
+    bool AlignConsecutiveSetProperty;
+    bool AlignConsecutiveFindPackage;
+    // Keyword arguments of project functions and macros, from the
+    // CommandKeywords block; these replace built-in signatures of the same
+    // name. Packed as "name\0KEYWORD\0...KEYWORD\0\0" per command and ended
+    // by an empty name, so the config stays a plain value.
+    char CommandKeywords[CONFIG_COMMAND_KEYWORDS_SIZE];
 } CMakeFormatConfig;
 
 void config_init_defaults(CMakeFormatConfig *config);
 bool config_load_from_file(CMakeFormatConfig *config, const char *filepath);
+// Like config_load_from_file, from the text of a .cmake_format.
+void config_load_from_string(CMakeFormatConfig *config, const char *text);
 void config_dump(const CMakeFormatConfig *config, FILE *out);
+// config_dump through a callback, for callers without stdio.
+typedef void (*ConfigWriter)(const char *text, size_t length, void *context);
+void config_write(const CMakeFormatConfig *config, ConfigWriter write, void *context);
+// The CommandKeywords entry for `name` (case-insensitive), pointing at its
+// first keyword, or NULL if there is none.
+const char *config_command_keywords(const CMakeFormatConfig *config, const char *name, size_t length);
 
 #endif
@@ -2,46 +2,40 @@ let formatTimer;
 
 let cmConfig, cmSource, cmOutput;
 
-// The global Module object configured by Emscripten
-var Module = {
-    onRuntimeInitialized: function() {
-        document.getElementById('loading').classList.add('hidden');
-        
-        cmConfig = CodeMirror.fromTextArea(document.getElementById('configInput'), {
-            mode: "yaml",
-            lineNumbers: true
-        });
+// Formatting runs in a Web Worker so typing never waits on the WASM module.
+const client = new FormatClient(new Worker('worker.js'));
 
-        cmSource = CodeMirror.fromTextArea(document.getElementById('sourceInput'), {
-            mode: "cmake",
-            lineNumbers: true
-        });
+client.ready.then((info) => {
+    document.getElementById('loading').classList.add('hidden');
 
-        cmOutput = CodeMirror.fromTextArea(document.getElementById('sourceOutput'), {
-            mode: "cmake",
-            lineNumbers: true,
-            readOnly: true
-        });
+    cmConfig = CodeMirror.fromTextArea(document.getElementById('configInput'), {
+        mode: "yaml",
+        lineNumbers: true
+    });
+
+    cmSource = CodeMirror.fromTextArea(document.getElementById('sourceInput'), {
+        mode: "cmake",
+        lineNumbers: true
+    });
 
-        try {
-            const configPtr = Module.ccall('get_default_config', 'number', [], []);
-            if (configPtr) {
-                cmConfig.setValue(Module.UTF8ToString(configPtr));
-                Module.ccall('free_string', null, ['number'], [configPtr]);
-            }
-        } catch (e) {
-            console.error("Failed to load default config from WASM:", e);
-            cmConfig.setValue("IndentWidth: 4\nColumnLimit: 80");
-        }
+    cmOutput = CodeMirror.fromTextArea(document.getElementById('sourceOutput'), {
+        mode: "cmake",
+        lineNumbers: true,
+        readOnly: true
+    });
+
+    cmConfig.setValue(info.defaultConfig || "IndentWidth: 4\nColumnLimit: 80");
+
+    triggerFormat(); // Initial format
 
-        triggerFormat(); // Initial format
-        
-        cmSource.on('change', debounceFormat);
-        cmConfig.on('change', debounceFormat);
+    cmSource.on('change', debounceFormat);
+    cmConfig.on('change', debounceFormat);
 
-        setupButtons();
-    }
-};
+    setupButtons();
+}, (e) => {
+    console.error(e);
+    document.getElementById('loading').textContent = "Failed to load WebAssembly engine.";
+});
 
 function setupButtons() {
     document.getElementById('btnCopyOutput').addEventListener('click', () => {
@@ -82,26 +76,10 @@ function debounceFormat() {
 }
 
 function triggerFormat() {
-    const source = cmSource.getValue();
-    const config = cmConfig.getValue();
-
-    try {
-        const resultPtr = Module.ccall(
-            'format_cmake_code',
-            'number',
-            ['string', 'string'],
-            [source, config]
-        );
-
-        if (resultPtr) {
-            const formattedString = Module.UTF8ToString(resultPtr);
-            cmOutput.setValue(formattedString);
-            Module.ccall('free_string', null, ['number'], [resultPtr]);
-        } else {
-            cmOutput.setValue("Error: Formatter returned NULL pointer.");
-        }
-    } catch (e) {
+    client.format(cmSource.getValue(), cmConfig.getValue()).then((formatted) => {
+        if (formatted !== null) cmOutput.setValue(formatted); // null: a newer edit superseded it
+    }, (e) => {
         console.error(e);
-        cmOutput.setValue("Fatal error calling WebAssembly module:\n" + e);
-    }
+        cmOutput.setValue("Fatal error calling WebAssembly module:\n" + e.message);
+    });
 }
@@ -0,0 +1,82 @@
+// Headless cold-start benchmark of the WebAssembly module under Node.
+//
+// Usage: node bench_startup.js <dir with cmakefmt*.js/.wasm> [runs]
+//
+// For each build present (cmakefmt_full, the reference built with filesystem
+// emulation when CMAKEFMT_BUILD_BENCHMARKS is on, and the lean cmakefmt and
+// cmakefmt_simd), prints the size of the .wasm and .js, raw and gzipped, and
+// the median time from creating a worker.js worker to receiving its first
+// formatted result. Every run is a fresh Node process.
+'use strict';
+
+const fs = require('fs');
+const path = require('path');
+const zlib = require('zlib');
+const { execFileSync } = require('child_process');
+
+const MODULES = ['cmakefmt_full', 'cmakefmt', 'cmakefmt_simd'];
+const SOURCE = 'project(demo C)\nadd_library(demo STATIC a.c b.c)\nif(WIN32)\ntarget_compile_definitions(demo PRIVATE WIN)\nendif()\n';
+
+// One cold start: spawn the worker, wait for ready, format once.
+async function child(moduleDir, name) {
+    const { Worker } = require('worker_threads');
+    const { performance } = require('perf_hooks');
+    const FormatClient = require('./format_client.js');
+
+    const start = performance.now();
+    const worker = new Worker(path.join(__dirname, 'worker.js'), {
+        workerData: { moduleDir, module: name, simd: name.endsWith('_simd') },
+    });
+    const client = new FormatClient(worker);
+    await client.ready;
+    const ready = performance.now();
+    const output = await client.format(SOURCE, '');
+    const formatted = performance.now();
+    await worker.terminate();
+    if (!output || !output.includes('  target_compile_definitions')) throw new Error('unexpected output: ' + output);
+    process.stdout.write(JSON.stringify({ ready: ready - start, formatted: formatted - start }));
+}
+
+function median(values) {
+    const sorted = values.slice().sort((a, b) => a - b);
+    return sorted[Math.floor(sorted.length / 2)];
+}
+
+function kib(bytes) {
+    return (bytes / 1024).toFixed(1);
+}
+
+function main() {
+    const moduleDir = path.resolve(process.argv[2] || __dirname);
+    const runs = parseInt(process.argv[3] || '9', 10);
+
+    console.log('module          wasm KiB (gz)    js KiB (gz)   ready ms   first format ms');
+    for (const name of MODULES) {
+        const wasmPath = path.join(moduleDir, name + '.wasm');
+        const jsPath = path.join(moduleDir, name + '.js');
+        if (!fs.existsSync(wasmPath) || !fs.existsSync(jsPath)) continue;
+
+        const wasm = fs.readFileSync(wasmPath);
+        const js = fs.readFileSync(jsPath);
+        const ready = [];
+        const formatted = [];
+        for (let i = 0; i < runs; i++) {
+            const result = JSON.parse(execFileSync(process.execPath, [__filename, '--child', moduleDir, name]));
+            ready.push(result.ready);
+            formatted.push(result.formatted);
+        }
+        console.log(name.padEnd(14) +
+                    (kib(wasm.length) + ' (' + kib(zlib.gzipSync(wasm).length) + ')').padStart(17) +
+                    (kib(js.length) + ' (' + kib(zlib.gzipSync(js).length) + ')').padStart(15) +
+                    median(ready).toFixed(1).padStart(11) + median(formatted).toFixed(1).padStart(18));
+    }
+}
+
+if (process.argv[2] === '--child') {
+    child(process.argv[3], process.argv[4]).catch((e) => {
+        console.error(e.stack || String(e));
+        process.exit(1);
+    });
+} else {
+    main();
+}
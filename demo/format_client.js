@@ -0,0 +1,67 @@
+// Main-thread side of worker.js. Accepts a browser Worker or a Node
+// worker_threads Worker.
+//
+// format() returns a promise for the formatted text. Each call supersedes the
+// previous one: an older promise resolves to null at once and its late result
+// is dropped, so a slow format can never overwrite the output of a newer edit.
+'use strict';
+
+class FormatClient {
+    constructor(worker) {
+        this.worker = worker;
+        this.latestId = 0;
+        this.current = null; // { id, resolve, reject } of the newest request
+        this.encoder = new TextEncoder();
+        this.decoder = new TextDecoder();
+
+        this.ready = new Promise((resolve, reject) => {
+            this.onReady = resolve;
+            this.onLoadError = reject;
+        });
+
+        const handler = (data) => this.onMessage(data);
+        if (typeof worker.on === 'function') {
+            worker.on('message', handler);
+        } else {
+            worker.onmessage = (event) => handler(event.data);
+        }
+    }
+
+    format(source, config) {
+        if (this.current) this.current.resolve(null);
+
+        const id = ++this.latestId;
+        const sourceBytes = this.encoder.encode(source);
+        const configBytes = this.encoder.encode(config);
+        const promise = new Promise((resolve, reject) => {
+            this.current = { id, resolve, reject };
+        });
+        this.worker.postMessage({ type: 'format', id, source: sourceBytes.buffer, config: configBytes.buffer },
+                                [sourceBytes.buffer, configBytes.buffer]);
+        return promise;
+    }
+
+    onMessage(data) {
+        if (data.type === 'ready') {
+            this.onReady({ defaultConfig: data.defaultConfig, simd: data.simd });
+            return;
+        }
+        if (data.type === 'error' && data.id === 0) {
+            this.onLoadError(new Error(data.message));
+            return;
+        }
+
+        const request = this.current;
+        if (!request || data.id !== request.id) return; // superseded
+        this.current = null;
+        if (data.type === 'result') {
+            request.resolve(this.decoder.decode(data.output));
+        } else {
+            request.reject(new Error(data.message));
+        }
+    }
+}
+
+if (typeof module !== 'undefined' && module.exports) {
+    module.exports = FormatClient;
+}
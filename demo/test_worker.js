@@ -0,0 +1,64 @@
+// Headless check of the demo's worker pipeline under Node.
+//
+// Usage: node test_worker.js <dir with cmakefmt*.js/.wasm> <tests dir>
+//
+// Formats every tests/<Name>/input.cmake through worker.js with both the
+// baseline and the SIMD128 build (when present) and compares the result with
+// expected.cmake, then checks that a burst of edits only delivers the newest.
+'use strict';
+
+const fs = require('fs');
+const path = require('path');
+const { Worker } = require('worker_threads');
+const FormatClient = require('./format_client.js');
+
+const moduleDir = path.resolve(process.argv[2] || __dirname);
+const testsDir = path.resolve(process.argv[3] || path.join(__dirname, '..', 'tests'));
+
+function fail(message) {
+    console.error('FAIL: ' + message);
+    process.exitCode = 1;
+}
+
+async function runVariant(simd) {
+    const worker = new Worker(path.join(__dirname, 'worker.js'), { workerData: { moduleDir, simd } });
+    const client = new FormatClient(worker);
+    const label = simd ? 'simd128' : 'baseline';
+
+    try {
+        const info = await client.ready;
+        if (!info.defaultConfig.includes('IndentWidth')) fail(label + ': default config lacks IndentWidth');
+
+        let checked = 0;
+        for (const name of fs.readdirSync(testsDir).sort()) {
+            const dir = path.join(testsDir, name);
+            const files = ['input.cmake', 'expected.cmake', '.cmake_format'].map((f) => path.join(dir, f));
+            if (!files.every((f) => fs.existsSync(f))) continue;
+
+            const [input, expected, config] = files.map((f) => fs.readFileSync(f, 'utf8'));
+            const output = await client.format(input, config);
+            if (output !== expected) fail(label + ': ' + name + ' output differs from expected.cmake');
+            checked++;
+        }
+
+        // Fire a burst of edits; every request but the last must be superseded.
+        const source = fs.readFileSync(path.join(testsDir, 'StressTestDocs', 'input.cmake'), 'utf8');
+        const config = fs.readFileSync(path.join(testsDir, 'StressTestDocs', '.cmake_format'), 'utf8');
+        const burst = [];
+        for (let i = 0; i < 20; i++) burst.push(client.format(source + 'set(EDIT ' + i + ')\n', config));
+        const results = await Promise.all(burst);
+        if (results.slice(0, -1).some((r) => r !== null)) fail(label + ': superseded request delivered a result');
+        if (!results[results.length - 1] || !results[results.length - 1].includes('set(EDIT 19)')) {
+            fail(label + ': newest request did not produce its result');
+        }
+
+        console.log(label + ': ' + checked + ' golden files ok');
+    } finally {
+        await worker.terminate();
+    }
+}
+
+(async () => {
+    await runVariant(false);
+    if (fs.existsSync(path.join(moduleDir, 'cmakefmt_simd.js'))) await runVariant(true);
+})().catch((e) => fail(e.stack || String(e)));
@@ -0,0 +1,127 @@
+// Runs the WebAssembly formatter off the main thread. Loaded as a browser Web
+// Worker by app.js, or as a Node worker_threads worker by test_worker.js.
+//
+// Requests carry the source and config as UTF-8 ArrayBuffers that the caller
+// transfers; the formatted text is transferred back the same way, so no string
+// is copied across threads. Only the newest pending request is formatted:
+// requests that arrive while a format is running supersede each other.
+'use strict';
+
+const isNode = typeof self === 'undefined';
+const nodeWorker = isNode ? require('worker_threads') : null;
+const port = isNode ? nodeWorker.parentPort : self;
+const options = isNode ? (nodeWorker.workerData || {}) : {};
+
+// Smallest module using a v128 instruction; validates only with SIMD128.
+const simdSupported = WebAssembly.validate(new Uint8Array([
+    0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0, 10, 10, 1, 8, 0, 65, 0, 253, 15, 253, 98, 11
+]));
+const useSimd = options.simd !== undefined ? options.simd : simdSupported;
+
+// The .wasm is compiled while the JavaScript glue is still loading (in the
+// browser, straight from the network stream) and handed to the glue through
+// its instantiateWasm hook, instead of the glue fetching it once it has run.
+function loadModule() {
+    const name = options.module || (useSimd ? 'cmakefmt_simd' : 'cmakefmt');
+    let compiled;
+    let factory;
+    if (isNode) {
+        const path = require('path');
+        const base = path.join(options.moduleDir || __dirname, name);
+        compiled = require('fs').promises.readFile(base + '.wasm').then((bytes) => WebAssembly.compile(bytes));
+        factory = require(base + '.js');
+    } else if (WebAssembly.compileStreaming) {
+        compiled = WebAssembly.compileStreaming(fetch(name + '.wasm'));
+        importScripts(name + '.js');
+        factory = createCmakefmt;
+    } else {
+        compiled = fetch(name + '.wasm').then((response) => response.arrayBuffer()).then(WebAssembly.compile);
+        importScripts(name + '.js');
+        factory = createCmakefmt;
+    }
+    return factory({
+        instantiateWasm(imports, receive) {
+            compiled.then((module) => WebAssembly.instantiate(module, imports).then((instance) => {
+                receive(instance, module);
+            })).catch(loadFailed);
+            return {};
+        },
+    });
+}
+
+let wasm = null;
+let pending = null;
+let scheduled = false;
+
+function copyIn(bytes) {
+    const ptr = wasm._malloc(bytes.length + 1);
+    wasm.HEAPU8.set(bytes, ptr);
+    wasm.HEAPU8[ptr + bytes.length] = 0;
+    return ptr;
+}
+
+// Copies a NUL-terminated result out of the heap and frees it.
+function takeResult(ptr) {
+    const heap = wasm.HEAPU8;
+    const end = heap.indexOf(0, ptr);
+    const bytes = heap.slice(ptr, end);
+    wasm._free_string(ptr);
+    return bytes;
+}
+
+function formatPending() {
+    scheduled = false;
+    const job = pending;
+    pending = null;
+    if (!job) return;
+
+    const sourcePtr = copyIn(new Uint8Array(job.source));
+    const configPtr = copyIn(new Uint8Array(job.config));
+    try {
+        const resultPtr = wasm._format_cmake_code(sourcePtr, configPtr);
+        if (!resultPtr) {
+            port.postMessage({ type: 'error', id: job.id, message: 'Formatter returned NULL pointer.' });
+            return;
+        }
+        const output = takeResult(resultPtr);
+        port.postMessage({ type: 'result', id: job.id, output: output.buffer }, [output.buffer]);
+    } catch (e) {
+        port.postMessage({ type: 'error', id: job.id, message: String(e) });
+    } finally {
+        wasm._free(sourcePtr);
+        wasm._free(configPtr);
+    }
+}
+
+// Defers formatting to a fresh task so that every request queued behind a
+// running format is delivered first and only the newest one is formatted.
+function schedule() {
+    if (scheduled || !wasm) return;
+    scheduled = true;
+    setTimeout(formatPending, 0);
+}
+
+function onRequest(data) {
+    if (data.type === 'format') {
+        pending = data;
+        schedule();
+    }
+}
+
+if (isNode) {
+    port.on('message', onRequest);
+} else {
+    port.onmessage = (event) => onRequest(event.data);
+}
+
+function loadFailed(e) {
+    port.postMessage({ type: 'error', id: 0, message: 'Failed to load WebAssembly module: ' + e });
+}
+
+loadModule().then((module) => {
+    wasm = module;
+    const configPtr = wasm._get_default_config();
+    const defaultConfig = configPtr ? new TextDecoder().decode(takeResult(configPtr)) : '';
+    port.postMessage({ type: 'ready', defaultConfig: defaultConfig, simd: useSimd });
+    schedule();
+}, loadFailed);
@@ -0,0 +1,247 @@
+#include "edits.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void add_edit(EditList *edits, SourceOffset offset, SourceOffset length,
+                     const char *replacement, size_t replacement_length) {
+    if (edits->count == edits->capacity) {
+        edits->capacity = edits->capacity == 0 ? 16 : edits->capacity * 2;
+        edits->edits = realloc(edits->edits, edits->capacity * sizeof(TextEdit));
+    }
+    edits->edits[edits->count++] = (TextEdit){ offset, length, replacement, replacement_length };
+}
+
+static void append(FormatBuffer *buffer, const char *text, size_t len) {
+    if (len == 0) return; // data may still be NULL
+    format_buffer_reserve(buffer, len);
+    memcpy(buffer->data + buffer->length, text, len);
+    buffer->length += len;
+}
+
+// Emits one edit for source[src, src_end) -> out[dst, dst_end), trimmed to the
+// part that actually differs.
+static void diff_segment(EditList *edits, const char *source, size_t src, size_t src_end,
+                         const char *out, size_t dst, size_t dst_end) {
+    while (src < src_end && dst < dst_end && source[src] == out[dst]) {
+        src++;
+        dst++;
+    }
+    while (src < src_end && dst < dst_end && source[src_end - 1] == out[dst_end - 1]) {
+        src_end--;
+        dst_end--;
+    }
+    if (src == src_end && dst == dst_end) return;
+    add_edit(edits, (SourceOffset)src, (SourceOffset)(src_end - src), out + dst, dst_end - dst);
+}
+
+// Source end of top-level child i, including the whitespace a command
+// without an argument list read ahead while looking for its '('.
+static size_t segment_end(const ASTNode *root, size_t i, size_t source_length) {
+    const ASTNode *child = root->children[i];
+    if (child->trailing.newlines == 0 && child->trailing.spaces == 0) return ast_node_end(child);
+    return i + 1 < root->child_count ? root->children[i + 1]->token.offset : source_length;
+}
+
+void format_ast_edits(ASTNode *root, const char *source, size_t source_length,
+                      const CMakeFormatConfig *config, FormatBuffer *formatted, EditList *edits) {
+    size_t *child_end = malloc((root->child_count + 1) * sizeof(size_t));
+    format_ast_with_marks(root, source, config, formatted, child_end);
+
+    // Each segment is a top-level child plus the whitespace in front of it;
+    // the formatter emits that whitespace right before it too.
+    size_t src = 0, dst = 0;
+    for (size_t i = 0; i < root->child_count; i++) {
+        size_t src_end = segment_end(root, i, source_length);
+        diff_segment(edits, source, src, src_end, formatted->data, dst, child_end[i]);
+        src = src_end;
+        dst = child_end[i];
+    }
+    diff_segment(edits, source, src, source_length, formatted->data, dst, formatted->length);
+
+    free(child_end);
+}
+
+void edit_list_free(EditList *edits) {
+    free(edits->edits);
+    edits->edits = NULL;
+    edits->count = 0;
+    edits->capacity = 0;
+}
+
+void edit_list_filter_ranges(EditList *edits, const SourceRange *ranges, size_t range_count) {
+    size_t kept = 0;
+    size_t r = 0;
+    for (size_t i = 0; i < edits->count; i++) {
+        const TextEdit *edit = &edits->edits[i];
+        // Both lists are sorted, so one forward pass over the ranges suffices.
+        while (r < range_count && ranges[r].end < edit->offset) r++;
+        if (r < range_count && edit->offset + edit->length >= ranges[r].start) {
+            edits->edits[kept++] = *edit;
+        }
+    }
+    edits->count = kept;
+}
+
+void apply_edits(const char *source, size_t source_length, const EditList *edits, FormatBuffer *out) {
+    size_t cursor = 0;
+    for (size_t i = 0; i < edits->count; i++) {
+        const TextEdit *edit = &edits->edits[i];
+        append(out, source + cursor, edit->offset - cursor);
+        append(out, edit->replacement, edit->replacement_length);
+        cursor = edit->offset + edit->length;
+    }
+    append(out, source + cursor, source_length - cursor);
+}
+
+// A run of edits rewritten as whole lines: old lines [first_line, last_line]
+// become the text in `replacement`.
+typedef struct {
+    size_t first_line;
+    size_t last_line;
+    FormatBuffer replacement;
+} ChangedLines;
+
+static size_t count_lines(const char *text, size_t len) {
+    size_t lines = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (text[i] == '\n') lines++;
+    }
+    if (len > 0 && text[len - 1] != '\n') lines++;
+    return lines;
+}
+
+// Prints text line by line with the given prefix.
+static void print_lines(FILE *out, char prefix, const char *text, size_t len) {
+    size_t start = 0;
+    while (start < len) {
+        const char *nl = memchr(text + start, '\n', len - start);
+        size_t end = nl ? (size_t)(nl - text) + 1 : len;
+        fputc(prefix, out);
+        fwrite(text + start, 1, end - start, out);
+        if (!nl) fputs("\n\\ No newline at end of file\n", out);
+        start = end;
+    }
+}
+
+#define LINE_START(l) ((size_t)((l) < lines->line_count ? lines->line_starts[l] : source_length))
+
+// Groups edits that touch the same or adjacent lines into whole-line changes.
+static size_t group_changes(const char *source, size_t source_length, const EditList *edits,
+                            const LineIndex *lines, ChangedLines **out) {
+    ChangedLines *changes = calloc(edits->count, sizeof(ChangedLines));
+    size_t change_count = 0;
+    for (size_t e = 0; e < edits->count;) {
+        ChangedLines *c = &changes[change_count++];
+        int line, column;
+        line_index_lookup(lines, edits->edits[e].offset, &line, &column);
+        c->first_line = (size_t)line - 1;
+        size_t cursor = LINE_START(c->first_line);
+
+        for (;;) {
+            const TextEdit *edit = &edits->edits[e];
+            size_t edit_end = edit->offset + edit->length;
+            append(&c->replacement, source + cursor, edit->offset - cursor);
+            append(&c->replacement, edit->replacement, edit->replacement_length);
+            cursor = edit_end;
+            line_index_lookup(lines, edit->length > 0 ? edit_end - 1 : edit_end, &line, &column);
+            c->last_line = (size_t)line - 1;
+            // Replacement text that stops mid-line continues into the next
+            // source line, which then has to be part of this change too.
+            if (cursor == LINE_START(c->last_line + 1) && cursor < source_length &&
+                c->replacement.length > 0 && c->replacement.data[c->replacement.length - 1] != '\n') {
+                c->last_line++;
+            }
+            e++;
+            if (e == edits->count) break;
+            line_index_lookup(lines, edits->edits[e].offset, &line, &column);
+            if ((size_t)line - 1 > c->last_line + 1) break;
+        }
+        size_t tail_end = LINE_START(c->last_line + 1);
+        append(&c->replacement, source + cursor, tail_end - cursor);
+    }
+
+    *out = changes;
+    return change_count;
+}
+
+#undef LINE_START
+
+void edit_list_count_lines(const char *source, size_t source_length, const EditList *edits,
+                           const LineIndex *lines, size_t *removed, size_t *added) {
+    *removed = 0;
+    *added = 0;
+    if (edits->count == 0) return;
+    ChangedLines *changes;
+    size_t change_count = group_changes(source, source_length, edits, lines, &changes);
+    for (size_t c = 0; c < change_count; c++) {
+        size_t old_start = lines->line_starts[changes[c].first_line];
+        size_t old_end = changes[c].last_line + 1 < lines->line_count ? lines->line_starts[changes[c].last_line + 1]
+                                                                      : source_length;
+        *removed += count_lines(source + old_start, old_end - old_start);
+        *added += count_lines(changes[c].replacement.data, changes[c].replacement.length);
+        format_buffer_free(&changes[c].replacement);
+    }
+    free(changes);
+}
+
+void write_unified_diff(const char *path, const char *source, size_t source_length,
+                        const EditList *edits, FILE *out) {
+    if (edits->count == 0) return;
+
+    LineIndex lines;
+    line_index_build(&lines, source, source_length);
+    size_t line_count = lines.line_count;
+    if (line_count > 1 && lines.line_starts[line_count - 1] == source_length) line_count--;
+
+#define LINE_START(l) ((size_t)((l) < lines.line_count ? lines.line_starts[l] : source_length))
+
+    ChangedLines *changes;
+    size_t change_count = group_changes(source, source_length, edits, &lines, &changes);
+
+    fprintf(out, "--- a/%s\n+++ b/%s\n", path, path);
+
+    long delta = 0; // new line number minus old line number so far
+    for (size_t h = 0; h < change_count;) {
+        // Extend the hunk while the next change's context overlaps this one.
+        size_t last = h;
+        while (last + 1 < change_count && changes[last + 1].first_line <= changes[last].last_line + 7) last++;
+
+        size_t start = changes[h].first_line >= 3 ? changes[h].first_line - 3 : 0;
+        size_t end = changes[last].last_line + 4; // exclusive
+        if (end > line_count) end = line_count;
+        if (end < changes[last].last_line + 1) end = changes[last].last_line + 1;
+
+        size_t old_count = count_lines(source + LINE_START(start), LINE_START(end) - LINE_START(start));
+        size_t new_count = old_count;
+        for (size_t c = h; c <= last; c++) {
+            new_count -= count_lines(source + LINE_START(changes[c].first_line),
+                                     LINE_START(changes[c].last_line + 1) - LINE_START(changes[c].first_line));
+            new_count += count_lines(changes[c].replacement.data, changes[c].replacement.length);
+        }
+
+        fprintf(out, "@@ -%zu,%zu +%zu,%zu @@\n",
+                old_count ? start + 1 : start, old_count,
+                new_count ? (size_t)((long)start + delta) + 1 : (size_t)((long)start + delta), new_count);
+
+        size_t line = start;
+        for (size_t c = h; c <= last; c++) {
+            print_lines(out, ' ', source + LINE_START(line), LINE_START(changes[c].first_line) - LINE_START(line));
+            size_t old_start = LINE_START(changes[c].first_line);
+            size_t old_end = LINE_START(changes[c].last_line + 1);
+            print_lines(out, '-', source + old_start, old_end - old_start);
+            print_lines(out, '+', changes[c].replacement.data, changes[c].replacement.length);
+            delta += (long)count_lines(changes[c].replacement.data, changes[c].replacement.length) -
+                     (long)count_lines(source + old_start, old_end - old_start);
+            line = changes[c].last_line + 1;
+        }
+        if (end > line) print_lines(out, ' ', source + LINE_START(line), LINE_START(end) - LINE_START(line));
+
+        h = last + 1;
+    }
+
+#undef LINE_START
+
+    for (size_t c = 0; c < change_count; c++) format_buffer_free(&changes[c].replacement);
+    free(changes);
+    line_index_free(&lines);
+}
@@ -0,0 +1,52 @@
+#ifndef EDITS_H
+#define EDITS_H
+
+#include "parser.h"
+#include "config.h"
+#include "formatter.h"
+#include <stdio.h>
+
+// Replace source[offset, offset + length) with replacement.
+typedef struct {
+    SourceOffset offset;
+    SourceOffset length;
+    const char *replacement; // points into the formatted buffer
+    size_t replacement_length;
+} TextEdit;
+
+// Inclusive byte range [start, end] of the source.
+typedef struct {
+    SourceOffset start;
+    SourceOffset end;
+} SourceRange;
+
+typedef struct {
+    TextEdit *edits;
+    size_t count;
+    size_t capacity;
+} EditList;
+
+// Formats the AST into `formatted` and fills `edits` with the minimal,
+// non-overlapping, ascending edits that turn the source into it. Each
+// top-level command is compared against its own formatted text, so there is
+// no general text diff involved.
+void format_ast_edits(ASTNode *root, const char *source, size_t source_length,
+                      const CMakeFormatConfig *config, FormatBuffer *formatted, EditList *edits);
+void edit_list_free(EditList *edits);
+// Drops every edit that touches none of the ranges, which must be sorted and
+// non-overlapping. Used for range formatting: the remaining edits only
+// rewrite commands in those ranges.
+void edit_list_filter_ranges(EditList *edits, const SourceRange *ranges, size_t range_count);
+// Writes the source with the edits applied into out.
+void apply_edits(const char *source, size_t source_length, const EditList *edits, FormatBuffer *out);
+
+// Counts the source lines a unified diff of the edits would remove and the
+// lines it would add.
+void edit_list_count_lines(const char *source, size_t source_length, const EditList *edits,
+                           const LineIndex *lines, size_t *removed, size_t *added);
+
+// Renders the edits as a unified diff with three lines of context.
+void write_unified_diff(const char *path, const char *source, size_t source_length,
+                        const EditList *edits, FILE *out);
+
+#endif
@@ -1,445 +1,470 @@
 #include "formatter.h"
+#include "signatures.h"
+#include "trace.h"
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
-static bool is_keyword(const char *str, size_t len) {
-    if (len == 0) return false;
-    for (size_t i = 0; i < len; i++) {
-        if (str[i] >= 'a' && str[i] <= 'z') return false; 
-    }
-    return true; 
-}
-
-static bool is_cmake_keyword(const char *str, size_t len) {
-    const char* keywords[] = {
-        "PROPERTIES", "PROPERTY", "TARGET", "TARGETS", "DESTINATION", "COMMAND", 
-        "DEPENDS", "WORKING_DIRECTORY", "COMMENT", "SOURCES", "PUBLIC", "PRIVATE", "INTERFACE", 
-        "FILES", "PROGRAMS", "INCLUDES", "EXPORT", "ALIAS", "STRINGS", "DEFINED", "COMPONENTS", 
-        "OPTIONAL", "REQUIRED", "APPEND", "ENV", "HINTS", "PATHS", "DOC", "VERSION", "LIBRARY", 
-        "RUNTIME", "ARCHIVE", "FRAMEWORK", "BUNDLE", "NAMELINK_ONLY", "NAMELINK_SKIP", 
-        "PERMISSIONS", "CONFIGURATIONS", "COMPONENT", "MATCHES", "EXISTS", "TEST", "POLICY",
-        "CACHE", "FORCE", "FILEPATH", "PATH", "STRING", "INTERNAL", "BOOL", "MAIN_DEPENDENCY",
-        "IMPLICIT_DEPENDS", "DEPFILE", "JOB_POOL", "VERBATIM", "COMMAND_EXPAND_LISTS",
-        "APPEND_STRING", "GLOBAL", "DIRECTORY", "SOURCE", "INSTALL", "BRIEF_DOCS", "FULL_DOCS",
-        "VARS", "ARGS", "PULL", "PUSH", "MACROS", "NAMES", "LANGUAGES", "CONFIGS"
-    };
-    for (size_t i = 0; i < sizeof(keywords)/sizeof(keywords[0]); i++) {
-        if (strlen(keywords[i]) == len && strncmp(str, keywords[i], len) == 0) return true;
+// Whether `word` is a keyword argument of the command: per the config's
+// CommandKeywords entry when it has one, else per the built-in signatures.
+static bool is_command_keyword(const char *config_keywords, CommandId command, const char *word, size_t len) {
+    if (config_keywords) {
+        for (const char *k = config_keywords; *k; k += strlen(k) + 1) {
+            if (strlen(k) == len && memcmp(k, word, len) == 0) return true;
+        }
+        return false;
     }
-    return false;
+    return command_has_keyword(command, word, len);
 }
 
-typedef struct {
-    int indent_level;
+typedef struct FormatterState {
+    const char *source;
+    int indent_level; // block depth of the current child, from the block index
     const CMakeFormatConfig *config;
-    FILE *out;
+    FormatBuffer *out;
     bool needs_indent;
     int arg_indent;
-    int align_opts_max_arg1;
-    int align_opts_max_arg2;
+    const struct AlignPlan *align;    // column widths of aligned command groups
+    const struct AlignGroup *group;   // group of the command being formatted, or NULL
+    size_t *child_end; // optional: output length after each top-level child
+    void (*format_command)(struct FormatterState *state, ASTNode *node); // the kernel for config
 } FormatterState;
 
+void format_buffer_reserve(FormatBuffer *buffer, size_t extra) {
+    if (buffer->length + extra <= buffer->capacity) return;
+    size_t capacity = buffer->capacity == 0 ? 4096 : buffer->capacity;
+    while (capacity < buffer->length + extra) capacity *= 2;
+    buffer->data = realloc(buffer->data, capacity);
+    buffer->capacity = capacity;
+}
+
+void format_buffer_free(FormatBuffer *buffer) {
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+}
+
+static void emit_char(FormatterState *state, char c) {
+    FormatBuffer *out = state->out;
+    if (out->length == out->capacity) format_buffer_reserve(out, 1);
+    out->data[out->length++] = c;
+}
+
+static void emit_text(FormatterState *state, const char *text, size_t len) {
+    FormatBuffer *out = state->out;
+    format_buffer_reserve(out, len);
+    memcpy(out->data + out->length, text, len);
+    out->length += len;
+}
+
 static void print_indent(FormatterState *state, int extra) {
     if (state->needs_indent) {
         int total = state->indent_level * state->config->IndentWidth + extra;
         if (state->config->UseTab) {
             int tabs = total / state->config->IndentWidth;
             int spaces = total % state->config->IndentWidth;
-            for (int i = 0; i < tabs; i++) fputc('\t', state->out);
-            for (int i = 0; i < spaces; i++) fputc(' ', state->out);
+            for (int i = 0; i < tabs; i++) emit_char(state, '\t');
+            for (int i = 0; i < spaces; i++) emit_char(state, ' ');
         } else {
-            for (int i = 0; i < total; i++) fputc(' ', state->out);
+            for (int i = 0; i < total; i++) emit_char(state, ' ');
         }
         state->needs_indent = false;
     }
 }
 
-static void increase_indent(FormatterState *state, const char *name, size_t len) {
-    if (len == 2 && strncasecmp(name, "if", 2) == 0) state->indent_level++;
-    else if (len == 5 && strncasecmp(name, "while", 5) == 0) state->indent_level++;
-    else if (len == 7 && strncasecmp(name, "foreach", 7) == 0) state->indent_level++;
-    else if (len == 8 && strncasecmp(name, "function", 8) == 0) state->indent_level++;
-    else if (len == 5 && strncasecmp(name, "macro", 5) == 0) state->indent_level++;
-    else if (len == 5 && strncasecmp(name, "block", 5) == 0) state->indent_level++;
-}
+// Alignment of consecutive commands.
+//
+// Runs of commands of the same kind, one per line with no blank line between
+// them (comment lines may sit in between), are aligned like a table: the first
+// `columns` arguments of each command are padded to the widest in the run. One
+// linear pass over the top-level children finds every run before formatting.
+
+#define ALIGN_MAX_COLUMNS 4
 
-static void decrease_indent(FormatterState *state, const char *name, size_t len) {
-    if ((len == 5 && strncasecmp(name, "endif", 5) == 0) ||
-        (len == 8 && strncasecmp(name, "endwhile", 8) == 0) ||
-        (len == 10 && strncasecmp(name, "endforeach", 10) == 0) ||
-        (len == 11 && strncasecmp(name, "endfunction", 11) == 0) ||
-        (len == 8 && strncasecmp(name, "endmacro", 8) == 0) ||
-        (len == 8 && strncasecmp(name, "endblock", 8) == 0)) {
-        if (state->indent_level > 0) state->indent_level--;
+typedef enum {
+    ALIGN_OPTION,
+    ALIGN_SET,
+    ALIGN_SET_PROPERTY,
+    ALIGN_FIND_PACKAGE,
+    ALIGN_KIND_COUNT,
+} AlignKind;
+
+static const struct {
+    const char *command;
+    int columns;
+    bool same_first_argument; // the run also ends where the first argument changes
+} align_kinds[ALIGN_KIND_COUNT] = {
+    [ALIGN_OPTION] = { "option", 2, false },             // name, help text
+    [ALIGN_SET] = { "set", 1, false },                   // variable
+    [ALIGN_SET_PROPERTY] = { "set_property", 4, true },  // scope, object, PROPERTY, name
+    [ALIGN_FIND_PACKAGE] = { "find_package", 1, false }, // package
+};
+
+static bool align_kind_enabled(const CMakeFormatConfig *config, AlignKind kind) {
+    switch (kind) {
+    case ALIGN_OPTION: return config->AlignOptions;
+    case ALIGN_SET: return config->AlignConsecutiveSet;
+    case ALIGN_SET_PROPERTY: return config->AlignConsecutiveSetProperty;
+    case ALIGN_FIND_PACKAGE: return config->AlignConsecutiveFindPackage;
+    default: return false;
     }
 }
 
-static void tweak_indent_for_command(FormatterState *state, const char *name, size_t len, int *temp_indent) {
-    *temp_indent = state->indent_level;
-    decrease_indent(state, name, len); // permanent decrease for ends
-    // Temporary decrease for else/elseif
-    if ((len == 4 && strncasecmp(name, "else", 4) == 0) ||
-        (len == 6 && strncasecmp(name, "elseif", 6) == 0)) {
-        *temp_indent = state->indent_level > 0 ? state->indent_level - 1 : 0;
-    } else {
-        *temp_indent = state->indent_level;
+typedef struct AlignGroup {
+    int widths[ALIGN_MAX_COLUMNS]; // zero past the kind's columns
+} AlignGroup;
+
+typedef struct AlignPlan {
+    int32_t *child_group; // per top-level child: index into groups, or -1
+    AlignGroup *groups;
+    size_t group_count;
+} AlignPlan;
+
+static const ASTNode *first_argument(const ASTNode *command) {
+    for (size_t c = 0; c < command->child_count; c++) {
+        const ASTNode *arg = command->children[c];
+        if (arg->type == NODE_UNQUOTED_ARGUMENT || arg->type == NODE_QUOTED_ARGUMENT ||
+            arg->type == NODE_BRACKET_ARGUMENT) {
+            return arg;
+        }
     }
+    return NULL;
 }
 
-static int get_single_line_length(ASTNode *node, FormatterState *state, int indent) {
-    int len = indent * state->config->IndentWidth;
-    bool need_space = false;
-    bool first_in_parens = false;
-    bool inside_parens = false;
-    for (size_t i = 0; i < node->child_count; i++) {
-        ASTNode *child = node->children[i];
-        if (child->type == NODE_IDENTIFIER) {
-            len += child->token.length;
-        } else if (child->type == NODE_LPAREN) {
-            if (state->config->SpaceBeforeParens && !inside_parens) len++;
-            len++;
-            inside_parens = true;
-            first_in_parens = true;
-            if (state->config->SpacesInParens) len++;
-            need_space = false;
-        } else if (child->type == NODE_RPAREN) {
-            if (state->config->SpacesInParens && !first_in_parens) len++;
-            len++;
-            inside_parens = false;
-            first_in_parens = false;
-        } else if (child->type == NODE_SPACE || child->type == NODE_NEWLINE) {
-           if (inside_parens) need_space = true;
-        } else if (child->type == NODE_LINE_COMMENT || child->type == NODE_BRACKET_COMMENT) {
-             return 999999; 
-        } else {
-             if (!first_in_parens && need_space) len++;
-             len += child->token.length;
-             need_space = true;
-             first_in_parens = false;
+static bool same_text(const char *source, const ASTNode *a, const ASTNode *b) {
+    if (!a || !b) return a == b;
+    return a->token.length == b->token.length &&
+           memcmp(token_text(source, a->token), token_text(source, b->token), a->token.length) == 0;
+}
+
+// The enabled alignment kind of a top-level child, or -1.
+static int align_kind_of(const ASTNode *child, const char *source, const CMakeFormatConfig *config) {
+    if (child->type != NODE_COMMAND_INVOCATION) return -1;
+    const ASTNode *id = child->children[0];
+    for (int kind = 0; kind < ALIGN_KIND_COUNT; kind++) {
+        size_t len = strlen(align_kinds[kind].command);
+        if (id->token.length == len && strncasecmp(token_text(source, id->token), align_kinds[kind].command, len) == 0) {
+            return align_kind_enabled(config, (AlignKind)kind) ? kind : -1;
         }
     }
-    return len;
+    return -1;
 }
 
-static void calculate_option_alignment(ASTNode *root, size_t start_idx, FormatterState *state) {
-    state->align_opts_max_arg1 = 0;
-    state->align_opts_max_arg2 = 0;
-    
-    size_t i = start_idx;
-    int blank_lines = 0;
+static void plan_alignment(ASTNode *root, const char *source, const CMakeFormatConfig *config, AlignPlan *plan) {
+    memset(plan, 0, sizeof(*plan));
+    bool any = false;
+    for (int kind = 0; kind < ALIGN_KIND_COUNT; kind++) any = any || align_kind_enabled(config, (AlignKind)kind);
+    if (!any || root->child_count == 0) return;
+
+    plan->child_group = malloc(root->child_count * sizeof(int32_t));
+    for (size_t i = 0; i < root->child_count; i++) plan->child_group[i] = -1;
+    size_t capacity = 0;
+
+    size_t i = 0;
     while (i < root->child_count) {
-        ASTNode *child = root->children[i];
-        if (child->type == NODE_NEWLINE) {
-            blank_lines++;
-            if (blank_lines > 1) break; // Break group on blank line
-        } else if (child->type == NODE_SPACE) {
-            // ignore
-        } else if (child->type == NODE_LINE_COMMENT || child->type == NODE_BRACKET_COMMENT) {
-            blank_lines = 0;
-        } else if (child->type == NODE_COMMAND_INVOCATION) {
-            blank_lines = 0;
-            ASTNode *cmd_id = NULL;
-            for (size_t c = 0; c < child->child_count; c++) {
-                if (child->children[c]->type == NODE_IDENTIFIER) {
-                    cmd_id = child->children[c];
-                    break;
-                }
-            }
-            if (!cmd_id || cmd_id->token.length != 6 || strncasecmp(cmd_id->token.start, "option", 6) != 0) {
-                break; // Not an option command
+        int kind = align_kind_of(root->children[i], source, config);
+        if (kind < 0) {
+            i++;
+            continue;
+        }
+        if (plan->group_count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            plan->groups = realloc(plan->groups, capacity * sizeof(AlignGroup));
+        }
+        AlignGroup *group = &plan->groups[plan->group_count];
+        memset(group, 0, sizeof(*group));
+
+        size_t members = 0, last = i;
+        for (size_t j = i; j < root->child_count; j++) {
+            ASTNode *child = root->children[j];
+            if (j > i && child->leading.newlines > 1) break;
+            if (child->type == NODE_LINE_COMMENT || child->type == NODE_BRACKET_COMMENT) continue;
+            if (align_kind_of(child, source, config) != kind) break;
+            if (align_kinds[kind].same_first_argument &&
+                !same_text(source, first_argument(child), first_argument(root->children[i]))) {
+                break;
             }
-            
-            int arg_idx = 0;
-            int arg1_len = 0;
-            int arg2_len = 0;
-            for (size_t c = 0; c < child->child_count; c++) {
-                ASTNode *arg_node = child->children[c];
-                if (arg_node->type == NODE_UNQUOTED_ARGUMENT || arg_node->type == NODE_QUOTED_ARGUMENT || arg_node->type == NODE_BRACKET_ARGUMENT) {
-                    if (arg_idx == 0) arg1_len = arg_node->token.length;
-                    else if (arg_idx == 1) arg2_len = arg_node->token.length;
-                    arg_idx++;
+
+            int column = 0;
+            for (size_t c = 0; c < child->child_count && column < align_kinds[kind].columns; c++) {
+                ASTNode *arg = child->children[c];
+                if (arg->type == NODE_UNQUOTED_ARGUMENT || arg->type == NODE_QUOTED_ARGUMENT ||
+                    arg->type == NODE_BRACKET_ARGUMENT) {
+                    if ((int)arg->width > group->widths[column]) group->widths[column] = (int)arg->width;
+                    column++;
                 }
             }
-            if (arg1_len > state->align_opts_max_arg1) state->align_opts_max_arg1 = arg1_len;
-            if (arg2_len > state->align_opts_max_arg2) state->align_opts_max_arg2 = arg2_len;
+            plan->child_group[j] = (int32_t)plan->group_count;
+            members++;
+            last = j;
+        }
+        if (members > 1) {
+            plan->group_count++;
         } else {
-            break;
+            plan->child_group[i] = -1;
         }
-        i++;
+        i = last + 1;
     }
 }
 
-static void format_command_invocation(FormatterState *state, ASTNode *node) {
-    const char *cmd_name = "";
-    size_t cmd_len = 0;
-    
-    // Find identifier
-    for (size_t i = 0; i < node->child_count; i++) {
-        if (node->children[i]->type == NODE_IDENTIFIER) {
-            cmd_name = node->children[i]->token.start;
-            cmd_len = node->children[i]->token.length;
-            break;
-        }
-    }
+static void free_alignment(AlignPlan *plan) {
+    free(plan->child_group);
+    free(plan->groups);
+}
 
-    int print_indent_level = state->indent_level;
-    tweak_indent_for_command(state, cmd_name, cmd_len, &print_indent_level);
-    
-    // Print indent
-    if (state->needs_indent) {
-        int total = print_indent_level * state->config->IndentWidth;
-        if (state->config->UseTab) {
-            int tabs = total / state->config->IndentWidth;
-            int spaces = total % state->config->IndentWidth;
-            for (int i = 0; i < tabs; i++) fputc('\t', state->out);
-            for (int i = 0; i < spaces; i++) fputc(' ', state->out);
-        } else {
-            for (int i = 0; i < total; i++) fputc(' ', state->out);
-        }
-        state->needs_indent = false;
-    }
+// Formatter kernels.
+//
+// The per-command loop tests a dozen config fields for every argument. It
+// lives in formatter_kernel.inc and is compiled once reading the config (the
+// generic kernel) and once per known config with those fields as constants,
+// so the compiler drops the branches they decide. init_state picks the first
+// kernel whose constants all match the config and falls back to the generic
+// one. A specialized config must give every field the kernel reads, or it
+// does not compile.
 
-    int single_line_len = get_single_line_length(node, state, print_indent_level);
-    bool force_single_line = (state->config->KeepShortStatementOnSameLine > 0 && single_line_len <= state->config->KeepShortStatementOnSameLine);
+typedef void (*CommandKernel)(FormatterState *state, ASTNode *node);
 
-    bool has_newlines = false;
-    for (size_t i = 0; i < node->child_count; i++) {
-        if (node->children[i]->type == NODE_NEWLINE) { has_newlines = true; break; }
+#define KERNEL_FN(name) name##_generic
+#define KERNEL_OPTION(field) (state->config->field)
+#include "formatter_kernel.inc"
+
+#define KERNEL_CONSTANT(prefix, field, value) prefix##_##field = (value),
+#define KERNEL_MATCHES(prefix, field, value) &&config->field == (value)
+
+// config_init_defaults, which is also this repository's .cmake_format.
+#define DEFAULTS_KERNEL(X, prefix) \
+    X(prefix, IndentWidth, 2) \
+    X(prefix, UseTab, false) \
+    X(prefix, SpacesInParens, false) \
+    X(prefix, SpaceBeforeParens, false) \
+    X(prefix, AlignArguments, true) \
+    X(prefix, ClosingParensOnNewLine, false) \
+    X(prefix, KeepShortStatementOnSameLine, 0) \
+    X(prefix, AlwaysBreakAfterFirstArgument, false) \
+    X(prefix, BreakBeforeKeywordArgument, false)
+
+enum { DEFAULTS_KERNEL(KERNEL_CONSTANT, defaults) };
+static bool matches_defaults(const CMakeFormatConfig *config) {
+    return true DEFAULTS_KERNEL(KERNEL_MATCHES, defaults);
+}
+#define KERNEL_FN(name) name##_defaults
+#define KERNEL_OPTION(field) defaults_##field
+#include "formatter_kernel.inc"
+
+static const struct {
+    const char *name;
+    bool (*matches)(const CMakeFormatConfig *config);
+    CommandKernel format_command;
+} kernels[] = {
+    { "defaults", matches_defaults, format_command_defaults },
+};
+
+bool formatter_force_generic = false;
+
+static size_t find_kernel(const CMakeFormatConfig *config) {
+    size_t count = sizeof(kernels) / sizeof(kernels[0]);
+    if (formatter_force_generic) return count;
+    for (size_t i = 0; i < count; i++) {
+        if (kernels[i].matches(config)) return i;
     }
+    return count;
+}
 
-    int positional_arg_count = 0;
-    int total_arg_count = 0;
-    bool emitted_internal_newline = false;
-
-    // Now format children
-    bool inside_parens = false;
-    bool need_space = false;
-    bool first_in_parens = false;
-    for (size_t i = 0; i < node->child_count; i++) {
-        ASTNode *child = node->children[i];
-        
-        if (child->type == NODE_IDENTIFIER) {
-            fprintf(state->out, "%.*s", (int)child->token.length, child->token.start);
-            state->arg_indent = (print_indent_level * state->config->IndentWidth) + child->token.length + 1; 
-        } else if (child->type == NODE_LPAREN) {
-            if (state->config->SpaceBeforeParens && !inside_parens) {
-                fputc(' ', state->out);
-                state->arg_indent++;
-            }
-            fputc('(', state->out);
-            inside_parens = true;
-            first_in_parens = true;
-            if (state->config->SpacesInParens) {
-                fputc(' ', state->out);
-            }
-            need_space = false;
-        } else if (child->type == NODE_RPAREN) {
-            bool should_put_newline = state->config->ClosingParensOnNewLine && !force_single_line && emitted_internal_newline;
-            if (should_put_newline) {
-                if (!state->needs_indent) {
-                    fputc('\n', state->out);
-                    state->needs_indent = true;
-                }
-            } else if (state->config->SpacesInParens && !first_in_parens && !state->needs_indent) { 
-                 fputc(' ', state->out);
-            }
-            
-            if (state->needs_indent) {
-                int total = print_indent_level * state->config->IndentWidth;
-                if (state->config->UseTab) {
-                    int tabs = total / state->config->IndentWidth;
-                    int spaces = total % state->config->IndentWidth;
-                    for (int s = 0; s < tabs; s++) fputc('\t', state->out);
-                    for (int s = 0; s < spaces; s++) fputc(' ', state->out);
-                } else {
-                    for (int s = 0; s < total; s++) fputc(' ', state->out);
-                }
-                state->needs_indent = false;
-            }
-            fputc(')', state->out);
-            inside_parens = false;
-            first_in_parens = false;
-        } else if (child->type == NODE_SPACE) {
-            if (inside_parens && force_single_line) need_space = true;
-        } else if (child->type == NODE_NEWLINE) {
-            bool is_before_closing = false;
-            if (inside_parens) {
-                bool is_last_newline = true;
-                for (size_t j = i + 1; j < node->child_count; j++) {
-                    if (node->children[j]->type == NODE_RPAREN) break;
-                    if (node->children[j]->type != NODE_SPACE && node->children[j]->type != NODE_NEWLINE) {
-                        is_last_newline = false;
-                        break;
-                    }
-                }
-                if (is_last_newline) {
-                    bool prev_is_line_comment = false;
-                    for (int j = (int)i - 1; j >= 0; j--) {
-                        if (node->children[j]->type == NODE_SPACE) continue;
-                        if (node->children[j]->type == NODE_LINE_COMMENT) prev_is_line_comment = true;
-                        break;
-                    }
-                    if (!prev_is_line_comment) {
-                        if (!state->config->ClosingParensOnNewLine) {
-                            is_before_closing = true;
-                        } else if (!emitted_internal_newline) {
-                            is_before_closing = true;
-                        }
-                    }
-                }
-            }
-            if (force_single_line || is_before_closing) {
-                if (inside_parens) need_space = true;
-            } else {
-                fputc('\n', state->out);
-                state->needs_indent = true;
-                need_space = false;
-                first_in_parens = false; // first line might be empty
-                if (inside_parens && !is_before_closing) {
-                    emitted_internal_newline = true;
-                }
-            }
-        } else if (child->type == NODE_LINE_COMMENT || child->type == NODE_BRACKET_COMMENT) {
-            if (!first_in_parens && need_space) { fputc(' ', state->out); need_space = false; }
-            if (state->needs_indent) {
-                int extra = inside_parens && !state->config->AlignArguments ? state->config->IndentWidth : 0;
-                if (inside_parens && state->config->AlignArguments) {
-                    for (int s = 0; s < state->arg_indent; s++) fputc(' ', state->out);
-                } else {
-                    int total = print_indent_level * state->config->IndentWidth + extra;
-                    if (state->config->UseTab) {
-                        int tabs = total / state->config->IndentWidth;
-                        int spaces = total % state->config->IndentWidth;
-                        for (int s = 0; s < tabs; s++) fputc('\t', state->out);
-                        for (int s = 0; s < spaces; s++) fputc(' ', state->out);
-                    } else {
-                        for (int s = 0; s < total; s++) fputc(' ', state->out);
-                    }
-                }
-                state->needs_indent = false;
-            }
-            fprintf(state->out, "%.*s", (int)child->token.length, child->token.start);
-            if (child->type == NODE_BRACKET_COMMENT) need_space = true; 
-            first_in_parens = false;
-        } else {
-            // Arguments
-            total_arg_count++;
-            bool is_kw = is_keyword(child->token.start, child->token.length);
-            if (!is_kw) positional_arg_count++;
-
-            bool break_for_keyword = state->config->BreakBeforeKeywordArgument &&
-                                     is_cmake_keyword(child->token.start, child->token.length);
-
-            if (!force_single_line && !state->needs_indent && !first_in_parens) {
-                if ((has_newlines && state->config->AlwaysBreakAfterFirstArgument && positional_arg_count == 2) || 
-                    break_for_keyword) {
-                    fputc('\n', state->out);
-                    state->needs_indent = true;
-                    need_space = false;
-                    emitted_internal_newline = true;
-                }
-            }
+const char *formatter_kernel_name(const CMakeFormatConfig *config) {
+    size_t i = find_kernel(config);
+    return i < sizeof(kernels) / sizeof(kernels[0]) ? kernels[i].name : "generic";
+}
 
-            if (state->needs_indent) {
-                int extra = inside_parens && !state->config->AlignArguments ? state->config->IndentWidth : 0;
-                if (inside_parens && state->config->AlignArguments) {
-                     for (int s = 0; s < state->arg_indent; s++) fputc(' ', state->out);
-                } else {
-                    int total = print_indent_level * state->config->IndentWidth + extra;
-                    if (state->config->UseTab) {
-                        int tabs = total / state->config->IndentWidth;
-                        int spaces = total % state->config->IndentWidth;
-                        for (int s = 0; s < tabs; s++) fputc('\t', state->out);
-                        for (int s = 0; s < spaces; s++) fputc(' ', state->out);
-                    } else {
-                        for (int s = 0; s < total; s++) fputc(' ', state->out);
-                    }
-                }
-                state->needs_indent = false;
-            } else if (!first_in_parens && need_space) {
-                fputc(' ', state->out);
-            }
-            fprintf(state->out, "%.*s", (int)child->token.length, child->token.start);
-
-            if (state->config->AlignOptions && cmd_len == 6 && strncasecmp(cmd_name, "option", 6) == 0) {
-                int pad = 0;
-                if (total_arg_count == 1) {
-                     pad = state->align_opts_max_arg1 - child->token.length;
-                } else if (total_arg_count == 2) {
-                     pad = state->align_opts_max_arg2 - child->token.length;
-                }
-                for (int p = 0; p < pad; p++) fputc(' ', state->out);
+static CommandKernel select_kernel(const CMakeFormatConfig *config) {
+    size_t i = find_kernel(config);
+    return i < sizeof(kernels) / sizeof(kernels[0]) ? kernels[i].format_command : format_command_generic;
+}
+
+// Formats root->children[begin, end). pending_newlines and has_content carry
+// the top-level loop state across ranges.
+static void format_children(FormatterState *state, ASTNode *root, size_t begin, size_t end,
+                            int *pending_newlines, bool *has_content) {
+    const BlockEntry *blocks = ast_block_index(root)->entries;
+    for (size_t i = begin; i < end; i++) {
+        ASTNode *child = root->children[i];
+        state->indent_level = blocks[i].depth;
+        *pending_newlines += (int)child->leading.newlines;
+
+        // output pending newlines before this token
+        if (*has_content) {
+            int to_print = *pending_newlines > 2 ? 2 : *pending_newlines;
+            for (int n = 0; n < to_print; n++) {
+                emit_char(state, '\n');
             }
+            if (to_print > 0) state->needs_indent = true;
+        }
+        *pending_newlines = 0;
+        *has_content = true;
 
-            need_space = true;
-            first_in_parens = false;
+        if (child->type == NODE_COMMAND_INVOCATION) {
+            int32_t group = state->align->child_group ? state->align->child_group[i] : -1;
+            state->group = group >= 0 ? &state->align->groups[group] : NULL;
+            state->format_command(state, child);
+        } else {
+            print_indent(state, 0);
+            emit_text(state, token_text(state->source, child->token), child->token.length);
         }
+        if (state->child_end) state->child_end[i] = state->out->length;
     }
+}
+
+static void init_state(FormatterState *state, const char *source, const CMakeFormatConfig *config, FormatBuffer *out) {
+    memset(state, 0, sizeof(*state));
+    state->source = source;
+    state->config = config;
+    state->out = out;
+    state->needs_indent = true;
+    state->format_command = select_kernel(config);
+}
 
-    increase_indent(state, cmd_name, cmd_len);
+void format_ast_to_buffer(ASTNode *root, const char *source, const CMakeFormatConfig *config, FormatBuffer *out) {
+    format_ast_with_marks(root, source, config, out, NULL);
 }
 
-void format_ast(ASTNode *root, const CMakeFormatConfig *config, FILE *out) {
-    FormatterState state = {0};
-    state.config = config;
-    state.out = out;
-    state.needs_indent = true;
+void format_ast_with_marks(ASTNode *root, const char *source, const CMakeFormatConfig *config,
+                           FormatBuffer *out, size_t *child_end) {
+    FormatterState state;
+    AlignPlan align;
+    plan_alignment(root, source, config, &align);
+    init_state(&state, source, config, out);
+    state.align = &align;
+    state.child_end = child_end;
 
     int pending_newlines = 0;
     bool has_content = false;
+    format_children(&state, root, 0, root->child_count, &pending_newlines, &has_content);
 
-    for (size_t i = 0; i < root->child_count; i++) {
-        ASTNode *child = root->children[i];
-        
-        if (child->type == NODE_SPACE) {
-            continue;
-        } else if (child->type == NODE_NEWLINE) {
-            pending_newlines++;
-        } else {
-            // output pending newlines before this token
-            if (has_content) {
-                int to_print = pending_newlines > 2 ? 2 : pending_newlines;
-                for (int n = 0; n < to_print; n++) {
-                    fputc('\n', state.out);
-                }
-                if (to_print > 0) state.needs_indent = true;
-            }
-            pending_newlines = 0;
-            has_content = true;
-
-            if (child->type == NODE_COMMAND_INVOCATION) {
-                ASTNode *cmd_id = NULL;
-                for (size_t c = 0; c < child->child_count; c++) {
-                    if (child->children[c]->type == NODE_IDENTIFIER) {
-                        cmd_id = child->children[c];
-                        break;
-                    }
-                }
-                bool is_option = cmd_id && cmd_id->token.length == 6 && strncasecmp(cmd_id->token.start, "option", 6) == 0;
-                
-                if (state.config->AlignOptions && is_option) {
-                    if (state.align_opts_max_arg1 == 0) {
-                        calculate_option_alignment(root, i, &state);
-                    }
-                } else {
-                    state.align_opts_max_arg1 = 0;
-                    state.align_opts_max_arg2 = 0;
-                }
+    if (has_content) {
+        emit_char(&state, '\n');
+    }
+    free_alignment(&align);
+}
 
-                format_command_invocation(&state, child);
-            } else if (child->type == NODE_LINE_COMMENT || child->type == NODE_BRACKET_COMMENT) {
-                print_indent(&state, 0);
-                fprintf(state.out, "%.*s", (int)child->token.length, child->token.start);
-            } else {
-                state.align_opts_max_arg1 = 0;
-                state.align_opts_max_arg2 = 0;
-                print_indent(&state, 0);
-                fprintf(state.out, "%.*s", (int)child->token.length, child->token.start);
-            }
+void format_ast(ASTNode *root, const char *source, const CMakeFormatConfig *config, FILE *out) {
+    FormatBuffer buffer = {0};
+    format_ast_to_buffer(root, source, config, &buffer);
+    fwrite(buffer.data, 1, buffer.length, out);
+    format_buffer_free(&buffer);
+}
+
+// Intra-file parallel formatting.
+//
+// The top-level children are cut into chunks at commands that start on a new
+// line. Block indentation comes from the parser's block index and the
+// alignment plan is computed up front and shared, so a chunk needs no state
+// from the ones before it. The chunks are formatted independently and
+// concatenated, which yields exactly the output of format_ast_to_buffer.
+
+#define PARALLEL_MIN_CHUNK_CHILDREN 256
+
+typedef struct {
+    size_t begin;
+    size_t end;
+    bool has_content;
+    FormatBuffer out;
+} FormatChunk;
+
+typedef struct {
+    ASTNode *root;
+    const char *source;
+    const CMakeFormatConfig *config;
+    AlignPlan align;
+    FormatChunk *chunks;
+    size_t chunk_count;
+    atomic_size_t next_chunk;
+} ParallelJob;
+
+static void format_chunk(ParallelJob *job, FormatChunk *chunk) {
+    FormatterState state;
+    init_state(&state, job->source, job->config, &chunk->out);
+    state.align = &job->align;
+
+    // The newlines before the chunk's first command are in its leading trivia.
+    int pending_newlines = 0;
+    bool has_content = chunk->has_content;
+    format_children(&state, job->root, chunk->begin, chunk->end, &pending_newlines, &has_content);
+}
+
+static void *parallel_worker(void *arg) {
+    ParallelJob *job = arg;
+    for (;;) {
+        size_t i = atomic_fetch_add(&job->next_chunk, 1);
+        if (i >= job->chunk_count) break;
+        uint64_t start = trace_now();
+        format_chunk(job, &job->chunks[i]);
+        trace_span("format chunk", start, NULL, job->chunks[i].out.length);
+    }
+    return NULL;
+}
+
+// Splits the file into at most max_chunks chunks. Each boundary is the first
+// command on a new line at least `target` children after the previous one;
+// splitting only there means the chunk begins with needs_indent set, like the
+// sequential path. Returns the number of chunks.
+static size_t plan_chunks(ASTNode *root, FormatChunk *chunks, size_t max_chunks) {
+    size_t target = root->child_count / max_chunks;
+    if (target < PARALLEL_MIN_CHUNK_CHILDREN) target = PARALLEL_MIN_CHUNK_CHILDREN;
+
+    size_t count = 0;
+    chunks[count++] = (FormatChunk){ .begin = 0 };
+    for (size_t i = target; i < root->child_count && count < max_chunks; i++) {
+        ASTNode *child = root->children[i];
+        if (child->type == NODE_COMMAND_INVOCATION && child->leading.newlines > 0) {
+            chunks[count - 1].end = i;
+            chunks[count++] = (FormatChunk){ .begin = i, .has_content = true };
+            i += target - 1;
         }
     }
+    chunks[count - 1].end = root->child_count;
+    return count;
+}
+
+void format_ast_parallel(ASTNode *root, const char *source, const CMakeFormatConfig *config,
+                         FormatBuffer *out, int threads) {
+    if (threads <= 1 || root->child_count < 2 * PARALLEL_MIN_CHUNK_CHILDREN) {
+        format_ast_to_buffer(root, source, config, out);
+        return;
+    }
 
-    if (has_content) {
-        fputc('\n', state.out);
+    // A few chunks per thread keeps the workers busy when chunk costs vary.
+    size_t max_chunks = (size_t)threads * 4;
+    ParallelJob job;
+    job.root = root;
+    job.source = source;
+    job.config = config;
+    plan_alignment(root, source, config, &job.align);
+    job.chunks = calloc(max_chunks, sizeof(FormatChunk));
+    job.chunk_count = plan_chunks(root, job.chunks, max_chunks);
+    atomic_init(&job.next_chunk, 0);
+
+    int workers = threads < (int)job.chunk_count ? threads : (int)job.chunk_count;
+    pthread_t *tids = malloc(sizeof(pthread_t) * workers);
+    int started = 0;
+    for (int t = 1; t < workers; t++) {
+        if (pthread_create(&tids[started], NULL, parallel_worker, &job) == 0) started++;
     }
+    parallel_worker(&job);
+    for (int t = 0; t < started; t++) pthread_join(tids[t], NULL);
+    free(tids);
+
+    size_t total = 0;
+    for (size_t c = 0; c < job.chunk_count; c++) total += job.chunks[c].out.length;
+    format_buffer_reserve(out, total + 1);
+    for (size_t c = 0; c < job.chunk_count; c++) {
+        memcpy(out->data + out->length, job.chunks[c].out.data, job.chunks[c].out.length);
+        out->length += job.chunks[c].out.length;
+        format_buffer_free(&job.chunks[c].out);
+    }
+    free(job.chunks);
+    free_alignment(&job.align);
+
+    out->data[out->length++] = '\n'; // there are at least 2 * PARALLEL_MIN_CHUNK_CHILDREN children
 }
@@ -5,6 +5,33 @@
 #include "config.h"
 #include <stdio.h>
 
-void format_ast(ASTNode *root, const CMakeFormatConfig *config, FILE *out);
+// Growable output buffer the formatter writes into.
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} FormatBuffer;
+
+void format_buffer_reserve(FormatBuffer *buffer, size_t extra);
+void format_buffer_free(FormatBuffer *buffer);
+
+void format_ast(ASTNode *root, const char *source, const CMakeFormatConfig *config, FILE *out);
+void format_ast_to_buffer(ASTNode *root, const char *source, const CMakeFormatConfig *config, FormatBuffer *out);
+// Like format_ast_to_buffer, and also stores in child_end[i] the output length
+// right after each top-level child i. child_end must have root->child_count
+// entries.
+void format_ast_with_marks(ASTNode *root, const char *source, const CMakeFormatConfig *config,
+                           FormatBuffer *out, size_t *child_end);
+// Formats chunks of top-level commands on up to `threads` threads. The output
+// is byte-identical to format_ast_to_buffer; small files are formatted inline.
+void format_ast_parallel(ASTNode *root, const char *source, const CMakeFormatConfig *config,
+                         FormatBuffer *out, int threads);
+
+// Commands are formatted by a kernel specialized for the config when one
+// matches it exactly, else by the generic one; this names the kernel chosen
+// ("generic" for the fallback). Setting formatter_force_generic makes every
+// format use the generic kernel, for comparing the two.
+const char *formatter_kernel_name(const CMakeFormatConfig *config);
+extern bool formatter_force_generic;
 
 #endif
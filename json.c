@@ -0,0 +1,310 @@
+#include "json.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    const char *current;
+    const char *end;
+} JsonParser;
+
+static void skip_ws(JsonParser *p) {
+    while (p->current < p->end &&
+           (*p->current == ' ' || *p->current == '\t' || *p->current == '\n' || *p->current == '\r')) {
+        p->current++;
+    }
+}
+
+static bool parse_value(JsonParser *p, JsonValue *value);
+
+static void push_utf8(FormatBuffer *buffer, unsigned cp) {
+    char bytes[4];
+    size_t n;
+    if (cp < 0x80) {
+        bytes[0] = (char)cp;
+        n = 1;
+    } else if (cp < 0x800) {
+        bytes[0] = (char)(0xC0 | (cp >> 6));
+        bytes[1] = (char)(0x80 | (cp & 0x3F));
+        n = 2;
+    } else if (cp < 0x10000) {
+        bytes[0] = (char)(0xE0 | (cp >> 12));
+        bytes[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        bytes[2] = (char)(0x80 | (cp & 0x3F));
+        n = 3;
+    } else {
+        bytes[0] = (char)(0xF0 | (cp >> 18));
+        bytes[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        bytes[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        bytes[3] = (char)(0x80 | (cp & 0x3F));
+        n = 4;
+    }
+    format_buffer_reserve(buffer, n);
+    memcpy(buffer->data + buffer->length, bytes, n);
+    buffer->length += n;
+}
+
+static bool parse_hex4(JsonParser *p, unsigned *out) {
+    if (p->end - p->current < 4) return false;
+    unsigned v = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = *p->current++;
+        v <<= 4;
+        if (c >= '0' && c <= '9') v |= (unsigned)(c - '0');
+        else if (c >= 'a' && c <= 'f') v |= (unsigned)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') v |= (unsigned)(c - 'A' + 10);
+        else return false;
+    }
+    *out = v;
+    return true;
+}
+
+static bool parse_string(JsonParser *p, char **out, size_t *out_length) {
+    if (p->current >= p->end || *p->current != '"') return false;
+    p->current++;
+
+    FormatBuffer buffer = {0};
+    while (p->current < p->end && *p->current != '"') {
+        // Copy the run of plain characters in one go.
+        const char *run = p->current;
+        while (p->current < p->end && *p->current != '"' && *p->current != '\\') p->current++;
+        if (p->current > run) {
+            size_t n = (size_t)(p->current - run);
+            format_buffer_reserve(&buffer, n);
+            memcpy(buffer.data + buffer.length, run, n);
+            buffer.length += n;
+        }
+        if (p->current >= p->end || *p->current == '"') break;
+
+        p->current++; // backslash
+        if (p->current >= p->end) break;
+        char esc = *p->current++;
+        char c;
+        switch (esc) {
+            case '"': c = '"'; break;
+            case '\\': c = '\\'; break;
+            case '/': c = '/'; break;
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'n': c = '\n'; break;
+            case 'r': c = '\r'; break;
+            case 't': c = '\t'; break;
+            case 'u': {
+                unsigned cp;
+                if (!parse_hex4(p, &cp)) goto fail;
+                if (cp >= 0xD800 && cp < 0xDC00 && p->end - p->current >= 6 &&
+                    p->current[0] == '\\' && p->current[1] == 'u') {
+                    unsigned low;
+                    p->current += 2;
+                    if (!parse_hex4(p, &low)) goto fail;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                }
+                push_utf8(&buffer, cp);
+                continue;
+            }
+            default: goto fail;
+        }
+        format_buffer_reserve(&buffer, 1);
+        buffer.data[buffer.length++] = c;
+    }
+    if (p->current >= p->end) goto fail;
+    p->current++; // closing quote
+
+    format_buffer_reserve(&buffer, 1);
+    buffer.data[buffer.length] = '\0';
+    *out = buffer.data;
+    *out_length = buffer.length;
+    return true;
+
+fail:
+    format_buffer_free(&buffer);
+    return false;
+}
+
+static bool parse_container(JsonParser *p, JsonValue *value, bool is_object) {
+    char close = is_object ? '}' : ']';
+    p->current++;
+    value->type = is_object ? JSON_OBJECT : JSON_ARRAY;
+    size_t capacity = 0;
+
+    skip_ws(p);
+    if (p->current < p->end && *p->current == close) {
+        p->current++;
+        return true;
+    }
+
+    for (;;) {
+        if (value->count == capacity) {
+            capacity = capacity == 0 ? 4 : capacity * 2;
+            value->items = realloc(value->items, capacity * sizeof(JsonValue));
+            if (is_object) value->keys = realloc(value->keys, capacity * sizeof(char *));
+        }
+        JsonValue *item = &value->items[value->count];
+        memset(item, 0, sizeof(*item));
+
+        skip_ws(p);
+        if (is_object) {
+            size_t key_length;
+            value->keys[value->count] = NULL;
+            if (!parse_string(p, &value->keys[value->count], &key_length)) {
+                value->count++;
+                return false;
+            }
+            skip_ws(p);
+            if (p->current >= p->end || *p->current != ':') {
+                value->count++;
+                return false;
+            }
+            p->current++;
+        }
+        value->count++;
+        if (!parse_value(p, item)) return false;
+
+        skip_ws(p);
+        if (p->current >= p->end) return false;
+        if (*p->current == ',') {
+            p->current++;
+            continue;
+        }
+        if (*p->current == close) {
+            p->current++;
+            return true;
+        }
+        return false;
+    }
+}
+
+static bool parse_literal(JsonParser *p, const char *literal) {
+    size_t n = strlen(literal);
+    if ((size_t)(p->end - p->current) < n || memcmp(p->current, literal, n) != 0) return false;
+    p->current += n;
+    return true;
+}
+
+static bool parse_value(JsonParser *p, JsonValue *value) {
+    skip_ws(p);
+    if (p->current >= p->end) return false;
+
+    switch (*p->current) {
+        case '{': return parse_container(p, value, true);
+        case '[': return parse_container(p, value, false);
+        case '"':
+            value->type = JSON_STRING;
+            return parse_string(p, &value->string, &value->string_length);
+        case 't':
+            value->type = JSON_BOOL;
+            value->boolean = true;
+            return parse_literal(p, "true");
+        case 'f':
+            value->type = JSON_BOOL;
+            return parse_literal(p, "false");
+        case 'n':
+            value->type = JSON_NULL;
+            return parse_literal(p, "null");
+        default: {
+            char buf[64];
+            size_t n = 0;
+            while (p->current < p->end && n < sizeof(buf) - 1 && *p->current != '\0' &&
+                   strchr("+-.0123456789eE", *p->current)) {
+                buf[n++] = *p->current++;
+            }
+            if (n == 0) return false;
+            buf[n] = '\0';
+            value->type = JSON_NUMBER;
+            value->number = strtod(buf, NULL);
+            return true;
+        }
+    }
+}
+
+static void free_contents(JsonValue *value) {
+    free(value->string);
+    for (size_t i = 0; i < value->count; i++) {
+        free_contents(&value->items[i]);
+        if (value->keys) free(value->keys[i]);
+    }
+    free(value->items);
+    free(value->keys);
+}
+
+JsonValue *json_parse(const char *text, size_t length) {
+    JsonParser p = { text, text + length };
+    JsonValue *value = calloc(1, sizeof(JsonValue));
+    if (!parse_value(&p, value)) {
+        json_free(value);
+        return NULL;
+    }
+    return value;
+}
+
+void json_free(JsonValue *value) {
+    if (!value) return;
+    free_contents(value);
+    free(value);
+}
+
+JsonValue *json_get(const JsonValue *object, const char *key) {
+    if (!object || object->type != JSON_OBJECT) return NULL;
+    for (size_t i = 0; i < object->count; i++) {
+        if (object->keys[i] && strcmp(object->keys[i], key) == 0) return &object->items[i];
+    }
+    return NULL;
+}
+
+const char *json_get_string(const JsonValue *object, const char *key) {
+    JsonValue *value = json_get(object, key);
+    return value && value->type == JSON_STRING ? value->string : NULL;
+}
+
+double json_get_number(const JsonValue *object, const char *key, double fallback) {
+    JsonValue *value = json_get(object, key);
+    return value && value->type == JSON_NUMBER ? value->number : fallback;
+}
+
+void json_write_raw(FormatBuffer *out, const char *text) {
+    size_t n = strlen(text);
+    format_buffer_reserve(out, n);
+    memcpy(out->data + out->length, text, n);
+    out->length += n;
+}
+
+void json_write_string(FormatBuffer *out, const char *text, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+    format_buffer_reserve(out, length + 2);
+    out->data[out->length++] = '"';
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)text[i];
+        const char *esc = NULL;
+        switch (c) {
+            case '"': esc = "\\\""; break;
+            case '\\': esc = "\\\\"; break;
+            case '\n': esc = "\\n"; break;
+            case '\r': esc = "\\r"; break;
+            case '\t': esc = "\\t"; break;
+            default: break;
+        }
+        if (esc) {
+            format_buffer_reserve(out, 2 + (length - i));
+            out->data[out->length++] = esc[0];
+            out->data[out->length++] = esc[1];
+        } else if (c < 0x20) {
+            format_buffer_reserve(out, 6 + (length - i));
+            memcpy(out->data + out->length, "\\u00", 4);
+            out->data[out->length + 4] = hex[c >> 4];
+            out->data[out->length + 5] = hex[c & 0xF];
+            out->length += 6;
+        } else {
+            out->data[out->length++] = (char)c;
+        }
+    }
+    format_buffer_reserve(out, 1);
+    out->data[out->length++] = '"';
+}
+
+void json_write_int(FormatBuffer *out, long long value) {
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), "%lld", value);
+    format_buffer_reserve(out, (size_t)n);
+    memcpy(out->data + out->length, buf, (size_t)n);
+    out->length += (size_t)n;
+}
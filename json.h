@@ -0,0 +1,42 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include "formatter.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT,
+} JsonType;
+
+typedef struct JsonValue {
+    JsonType type;
+    bool boolean;
+    double number;
+    char *string; // NUL-terminated, unescaped
+    size_t string_length;
+    struct JsonValue *items; // array elements or object values
+    char **keys; // object keys, parallel to items
+    size_t count;
+} JsonValue;
+
+// Parses a complete JSON document. Returns NULL on malformed input.
+JsonValue *json_parse(const char *text, size_t length);
+void json_free(JsonValue *value);
+
+// Lookup helpers; all of them accept NULL and return NULL/the fallback.
+JsonValue *json_get(const JsonValue *object, const char *key);
+const char *json_get_string(const JsonValue *object, const char *key);
+double json_get_number(const JsonValue *object, const char *key, double fallback);
+
+// Writers appending to a FormatBuffer.
+void json_write_raw(FormatBuffer *out, const char *text);
+void json_write_string(FormatBuffer *out, const char *text, size_t length);
+void json_write_int(FormatBuffer *out, long long value);
+
+#endif
@@ -1,12 +1,45 @@
 #include "lexer.h"
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define LEXER_SIMD 1
+typedef __m128i Vec;
+#define vec_load(p) _mm_load_si128((const __m128i *)(p))
+#define vec_eq(v, c) _mm_cmpeq_epi8((v), _mm_set1_epi8(c))
+#define vec_or(a, b) _mm_or_si128((a), (b))
+#define vec_mask(v) ((unsigned)_mm_movemask_epi8(v))
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define LEXER_SIMD 1
+typedef v128_t Vec;
+#define vec_load(p) wasm_v128_load(p)
+#define vec_eq(v, c) wasm_i8x16_eq((v), wasm_i8x16_splat(c))
+#define vec_or(a, b) wasm_v128_or((a), (b))
+#define vec_mask(v) ((unsigned)wasm_i8x16_bitmask(v))
+#else
+#define LEXER_SIMD 0
+#endif
+
+#if defined(__SANITIZE_ADDRESS__)
+#define LEXER_NO_ASAN __attribute__((no_sanitize_address))
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define LEXER_NO_ASAN __attribute__((no_sanitize_address))
+#endif
+#endif
+#ifndef LEXER_NO_ASAN
+#define LEXER_NO_ASAN
+#endif
 
 void lexer_init(Lexer *lexer, const char *source) {
+    lexer->source = source;
     lexer->start = source;
     lexer->current = source;
-    lexer->line = 1;
-    lexer->column = 1;
+    lexer->error = NULL;
 }
 
 static bool is_at_end(Lexer *lexer) {
@@ -15,7 +48,6 @@ static bool is_at_end(Lexer *lexer) {
 
 static char advance(Lexer *lexer) {
     lexer->current++;
-    lexer->column++;
     return lexer->current[-1];
 }
 
@@ -23,38 +55,90 @@ static char peek(Lexer *lexer) {
     return *lexer->current;
 }
 
-static char peek_next(Lexer *lexer) {
-    if (is_at_end(lexer)) return '\0';
-    return lexer->current[1];
-}
-
 static bool match(Lexer *lexer, char expected) {
     if (is_at_end(lexer)) return false;
     if (*lexer->current != expected) return false;
     lexer->current++;
-    lexer->column++;
     return true;
 }
 
+// Byte classes the scanners below stop at. Every set includes the
+// terminating NUL so a scan never runs off the end of the source.
+static inline bool is_line_end(char c) {
+    return c == '\n' || c == '\0';
+}
+
+static inline bool is_quoted_stop(char c) {
+    return c == '"' || c == '\\' || c == '\0';
+}
+
+static inline bool is_bracket_stop(char c) {
+    return c == ']' || c == '\0';
+}
+
+static inline bool is_unquoted_stop(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '(' || c == ')' ||
+           c == '#' || c == '"' || c == '\\' || c == '\0';
+}
+
+#if LEXER_SIMD
+static inline Vec match_line_end(Vec v) {
+    return vec_or(vec_eq(v, '\n'), vec_eq(v, '\0'));
+}
+
+static inline Vec match_quoted_stop(Vec v) {
+    return vec_or(vec_or(vec_eq(v, '"'), vec_eq(v, '\\')), vec_eq(v, '\0'));
+}
+
+static inline Vec match_bracket_stop(Vec v) {
+    return vec_or(vec_eq(v, ']'), vec_eq(v, '\0'));
+}
+
+static inline Vec match_unquoted_stop(Vec v) {
+    Vec space = vec_or(vec_or(vec_eq(v, ' '), vec_eq(v, '\t')), vec_or(vec_eq(v, '\n'), vec_eq(v, '\r')));
+    Vec punct = vec_or(vec_or(vec_eq(v, '('), vec_eq(v, ')')), vec_or(vec_eq(v, '#'), vec_eq(v, '"')));
+    return vec_or(vec_or(space, punct), vec_or(vec_eq(v, '\\'), vec_eq(v, '\0')));
+}
+
+// Returns the first byte at or after p in the class, 16 bytes per step. Loads
+// are aligned, so they never cross a page and may safely read past the NUL.
+#define DEFINE_SCANNER(name, vector_match, scalar_match)                           \
+    LEXER_NO_ASAN static const char *name(const char *p) {                          \
+        const char *block = (const char *)((uintptr_t)p & ~(uintptr_t)15);          \
+        unsigned mask = vec_mask(vector_match(vec_load(block))) >> (p - block);     \
+        if (mask) return p + __builtin_ctz(mask);                                   \
+        for (;;) {                                                                  \
+            block += 16;                                                            \
+            mask = vec_mask(vector_match(vec_load(block)));                         \
+            if (mask) return block + __builtin_ctz(mask);                           \
+        }                                                                           \
+    }
+#else
+#define DEFINE_SCANNER(name, vector_match, scalar_match)                           \
+    static const char *name(const char *p) {                                        \
+        while (!scalar_match(*p)) p++;                                              \
+        return p;                                                                   \
+    }
+#endif
+
+DEFINE_SCANNER(scan_line_end, match_line_end, is_line_end)
+DEFINE_SCANNER(scan_quoted_stop, match_quoted_stop, is_quoted_stop)
+DEFINE_SCANNER(scan_bracket_stop, match_bracket_stop, is_bracket_stop)
+DEFINE_SCANNER(scan_unquoted_stop, match_unquoted_stop, is_unquoted_stop)
+
 static Token make_token(Lexer *lexer, TokenType type) {
     Token token;
     token.type = type;
-    token.start = lexer->start;
-    token.length = (size_t)(lexer->current - lexer->start);
-    token.line = lexer->line;
-    // The column logic must account for the token's start column
-    token.column = lexer->column - token.length;
+    token.offset = (SourceOffset)(lexer->start - lexer->source);
+    token.length = (SourceOffset)(lexer->current - lexer->start);
     return token;
 }
 
+// Error tokens still cover the consumed source text so nothing is lost when
+// the parser keeps them; the message is reported through lexer->error.
 static Token error_token(Lexer *lexer, const char *message) {
-    Token token;
-    token.type = TOKEN_ERROR;
-    token.start = message;
-    token.length = strlen(message);
-    token.line = lexer->line;
-    token.column = lexer->column;
-    return token;
+    lexer->error = message;
+    return make_token(lexer, TOKEN_ERROR);
 }
 
 static void skip_whitespace(Lexer *lexer) {
@@ -71,25 +155,18 @@ static Token number_of_equals(Lexer *lexer, int *equals_count) {
 }
 
 static Token bracket_content(Lexer *lexer, int equals_count, TokenType type) {
-    while (!is_at_end(lexer)) {
-        char c = peek(lexer);
-        if (c == '\n') {
-            lexer->line++;
-            lexer->column = 1;
-            lexer->current++;
-        } else if (c == ']') {
-            advance(lexer);
-            int current_equals = 0;
-            while (peek(lexer) == '=') {
-                advance(lexer);
-                current_equals++;
-            }
-            if (peek(lexer) == ']' && current_equals == equals_count) {
-                advance(lexer); // consume closing bracket
-                return make_token(lexer, type);
-            }
-        } else {
+    for (;;) {
+        lexer->current = scan_bracket_stop(lexer->current);
+        if (is_at_end(lexer)) break;
+        advance(lexer);
+        int current_equals = 0;
+        while (peek(lexer) == '=') {
             advance(lexer);
+            current_equals++;
+        }
+        if (peek(lexer) == ']' && current_equals == equals_count) {
+            advance(lexer); // consume closing bracket
+            return make_token(lexer, type);
         }
     }
     return error_token(lexer, "Unterminated bracket argument/comment.");
@@ -110,16 +187,12 @@ Token lexer_next_token(Lexer *lexer) {
     }
 
     if (c == '\n') {
-        lexer->line++;
-        lexer->column = 1;
         return make_token(lexer, TOKEN_NEWLINE);
     }
     
     // Windows CRLF
     if (c == '\r' && peek(lexer) == '\n') {
         advance(lexer);
-        lexer->line++;
-        lexer->column = 1;
         return make_token(lexer, TOKEN_NEWLINE);
     }
 
@@ -138,30 +211,22 @@ Token lexer_next_token(Lexer *lexer) {
             }
             // fallback to line comment if it wasn't a valid bracket comment open?
             // Actually CMake says #[=[ is a bracket comment, but #[= without another [ is just a line comment.
-             while (peek(lexer) != '\n' && !is_at_end(lexer)) {
-                 advance(lexer);
-             }
+             lexer->current = scan_line_end(lexer->current);
              return make_token(lexer, TOKEN_LINE_COMMENT);
         } else {
-            while (peek(lexer) != '\n' && !is_at_end(lexer)) {
-                advance(lexer);
-            }
+            lexer->current = scan_line_end(lexer->current);
             return make_token(lexer, TOKEN_LINE_COMMENT);
         }
     }
 
     if (c == '"') {
-        while (peek(lexer) != '"' && !is_at_end(lexer)) {
-            if (peek(lexer) == '\\' && peek_next(lexer) == '"') {
-                advance(lexer);
-                advance(lexer);
-            } else if (peek(lexer) == '\n') {
-                lexer->line++;
-                lexer->column = 1;
-                advance(lexer);
-            } else {
-                advance(lexer);
-            }
+        for (;;) {
+            lexer->current = scan_quoted_stop(lexer->current);
+            if (peek(lexer) != '\\') break;
+            // An escaped quote does not close the string; any other backslash
+            // is ordinary content.
+            advance(lexer);
+            if (peek(lexer) == '"') advance(lexer);
         }
         if (is_at_end(lexer)) return error_token(lexer, "Unterminated string.");
         advance(lexer); // close quote
@@ -171,7 +236,6 @@ Token lexer_next_token(Lexer *lexer) {
     if (c == '[') {
         int equals_count;
         const char *fallback = lexer->current;
-        int fallback_col = lexer->column;
         number_of_equals(lexer, &equals_count);
         if (peek(lexer) == '[') {
             advance(lexer);
@@ -179,29 +243,17 @@ Token lexer_next_token(Lexer *lexer) {
         }
         // If it's not a bracket argument, it's just an unquoted argument
         lexer->current = fallback;
-        lexer->column = fallback_col;
     }
 
     // Unquoted argument
     // Allowed chars in unquoted: anything except whitespace, (), #, ", \
     // Wait, \ can escape those. 
-    while (!is_at_end(lexer)) {
-        char p = peek(lexer);
-        if (p == ' ' || p == '\t' || p == '\n' || p == '\r' || p == '(' || p == ')' || p == '#' || p == '"') {
-            break;
-        }
-        if (p == '\\') {
-            // escape sequence
-            advance(lexer);
-            if (!is_at_end(lexer)) {
-                char esc = peek(lexer);
-                if (esc == '\n') {
-                    lexer->line++;
-                    lexer->column = 1;
-                }
-                advance(lexer);
-            }
-        } else {
+    for (;;) {
+        lexer->current = scan_unquoted_stop(lexer->current);
+        if (peek(lexer) != '\\') break;
+        // escape sequence
+        advance(lexer);
+        if (!is_at_end(lexer)) {
             advance(lexer);
         }
     }
@@ -210,3 +262,39 @@ Token lexer_next_token(Lexer *lexer) {
     // We'll leave it as UNQUOTED_ARGUMENT and let the parser decide if it's an IDENTIFIER.
     return make_token(lexer, TOKEN_UNQUOTED_ARGUMENT);
 }
+
+void line_index_build(LineIndex *index, const char *source, size_t length) {
+    size_t capacity = 64;
+    index->line_starts = malloc(capacity * sizeof(SourceOffset));
+    index->line_starts[0] = 0;
+    index->line_count = 1;
+
+    const char *p = source;
+    const char *end = source + length;
+    while ((p = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+        p++;
+        if (index->line_count == capacity) {
+            capacity *= 2;
+            index->line_starts = realloc(index->line_starts, capacity * sizeof(SourceOffset));
+        }
+        index->line_starts[index->line_count++] = (SourceOffset)(p - source);
+    }
+}
+
+void line_index_free(LineIndex *index) {
+    free(index->line_starts);
+    index->line_starts = NULL;
+    index->line_count = 0;
+}
+
+void line_index_lookup(const LineIndex *index, SourceOffset offset, int *line, int *column) {
+    // Last line start that is <= offset
+    size_t lo = 0, hi = index->line_count;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (index->line_starts[mid] <= offset) lo = mid;
+        else hi = mid;
+    }
+    *line = (int)lo + 1;
+    *column = (int)(offset - index->line_starts[lo]) + 1;
+}
@@ -3,6 +3,7 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef enum {
     TOKEN_ERROR,
@@ -25,22 +26,48 @@ typedef enum {
     TOKEN_NEWLINE,
 } TokenType;
 
+// Byte offsets into the source buffer. 32 bits keep a Token at 12 bytes;
+// build with CMAKEFMT_LARGE_FILES for sources of 4 GiB and beyond.
+#ifdef CMAKEFMT_LARGE_FILES
+typedef uint64_t SourceOffset;
+#define SOURCE_OFFSET_MAX UINT64_MAX
+#else
+typedef uint32_t SourceOffset;
+#define SOURCE_OFFSET_MAX UINT32_MAX
+#endif
+
+// A token only records where it lives in the source. Line and column are
+// derived on demand through a LineIndex.
 typedef struct {
     TokenType type;
-    const char *start;
-    size_t length;
-    int line;
-    int column;
+    SourceOffset offset;
+    SourceOffset length;
 } Token;
 
 typedef struct {
+    const char *source;
     const char *start;
     const char *current;
-    int line;
-    int column;
+    const char *error; // message for the last TOKEN_ERROR, NULL otherwise
 } Lexer;
 
 void lexer_init(Lexer *lexer, const char *source);
 Token lexer_next_token(Lexer *lexer);
 
+static inline const char *token_text(const char *source, Token token) {
+    return source + token.offset;
+}
+
+// Sorted start offsets of every line, built only when a position has to be
+// reported (diagnostics, range formatting).
+typedef struct {
+    SourceOffset *line_starts;
+    size_t line_count;
+} LineIndex;
+
+void line_index_build(LineIndex *index, const char *source, size_t length);
+void line_index_free(LineIndex *index);
+// Converts a byte offset to a 1-based line and column.
+void line_index_lookup(const LineIndex *index, SourceOffset offset, int *line, int *column);
+
 #endif
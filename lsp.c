@@ -0,0 +1,445 @@
+#include "lsp.h"
+#include "parser.h"
+#include "formatter.h"
+#include "edits.h"
+#include "json.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// Minimal Language Server Protocol front end: JSON-RPC over stdio with
+// Content-Length framing. Open documents keep their text and AST in memory;
+// incremental didChange edits re-parse only the top-level commands they touch.
+
+typedef struct {
+    char *uri;
+    char *text;
+    size_t length;
+    size_t capacity;
+    ASTNode *ast;
+    LineIndex lines;
+    bool lines_valid;
+} Document;
+
+typedef struct {
+    char *path;
+    CMakeFormatConfig config;
+    bool loaded;
+} WorkspaceConfig;
+
+typedef struct {
+    FILE *in;
+    FILE *out;
+    const CMakeFormatConfig *fallback_config;
+    Document *documents;
+    size_t document_count;
+    WorkspaceConfig *workspaces;
+    size_t workspace_count;
+    bool shutdown_requested;
+} Server;
+
+// --- Transport ---
+
+static char *read_message(FILE *in, size_t *length) {
+    char header[256];
+    long content_length = -1;
+    for (;;) {
+        if (!fgets(header, sizeof(header), in)) return NULL;
+        if (strcmp(header, "\r\n") == 0 || strcmp(header, "\n") == 0) {
+            if (content_length >= 0) break;
+            continue;
+        }
+        if (strncasecmp(header, "Content-Length:", 15) == 0) {
+            content_length = strtol(header + 15, NULL, 10);
+        }
+    }
+
+    char *body = malloc((size_t)content_length + 1);
+    if (fread(body, 1, (size_t)content_length, in) != (size_t)content_length) {
+        free(body);
+        return NULL;
+    }
+    body[content_length] = '\0';
+    *length = (size_t)content_length;
+    return body;
+}
+
+static void send_message(Server *server, const FormatBuffer *json) {
+    fprintf(server->out, "Content-Length: %zu\r\n\r\n", json->length);
+    fwrite(json->data, 1, json->length, server->out);
+    fflush(server->out);
+}
+
+static void write_id(FormatBuffer *out, const JsonValue *id) {
+    if (id && id->type == JSON_NUMBER) json_write_int(out, (long long)id->number);
+    else if (id && id->type == JSON_STRING) json_write_string(out, id->string, id->string_length);
+    else json_write_raw(out, "null");
+}
+
+static void send_result(Server *server, const JsonValue *id, const char *result) {
+    FormatBuffer out = {0};
+    json_write_raw(&out, "{\"jsonrpc\":\"2.0\",\"id\":");
+    write_id(&out, id);
+    json_write_raw(&out, ",\"result\":");
+    json_write_raw(&out, result);
+    json_write_raw(&out, "}");
+    send_message(server, &out);
+    format_buffer_free(&out);
+}
+
+static void send_error(Server *server, const JsonValue *id, int code, const char *message) {
+    FormatBuffer out = {0};
+    json_write_raw(&out, "{\"jsonrpc\":\"2.0\",\"id\":");
+    write_id(&out, id);
+    json_write_raw(&out, ",\"error\":{\"code\":");
+    json_write_int(&out, code);
+    json_write_raw(&out, ",\"message\":");
+    json_write_string(&out, message, strlen(message));
+    json_write_raw(&out, "}}");
+    send_message(server, &out);
+    format_buffer_free(&out);
+}
+
+// --- Workspace configs ---
+
+static char *uri_to_path(const char *uri) {
+    if (strncmp(uri, "file://", 7) == 0) uri += 7;
+    size_t n = strlen(uri);
+    char *path = malloc(n + 1);
+    size_t j = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (uri[i] == '%' && i + 2 < n) {
+            char hex[3] = { uri[i + 1], uri[i + 2], '\0' };
+            path[j++] = (char)strtol(hex, NULL, 16);
+            i += 2;
+        } else {
+            path[j++] = uri[i];
+        }
+    }
+    while (j > 1 && path[j - 1] == '/') j--;
+    path[j] = '\0';
+    return path;
+}
+
+static void add_workspace(Server *server, const char *uri) {
+    server->workspaces = realloc(server->workspaces, (server->workspace_count + 1) * sizeof(WorkspaceConfig));
+    WorkspaceConfig *ws = &server->workspaces[server->workspace_count++];
+    ws->path = uri_to_path(uri);
+    ws->loaded = false;
+}
+
+static void remove_workspace(Server *server, const char *uri) {
+    char *path = uri_to_path(uri);
+    for (size_t i = 0; i < server->workspace_count; i++) {
+        if (strcmp(server->workspaces[i].path, path) == 0) {
+            free(server->workspaces[i].path);
+            server->workspaces[i] = server->workspaces[--server->workspace_count];
+            break;
+        }
+    }
+    free(path);
+}
+
+// Config of the innermost workspace folder containing the document, loaded
+// from its .cmake_format once and cached.
+static const CMakeFormatConfig *config_for(Server *server, const char *uri) {
+    char *path = uri_to_path(uri);
+    WorkspaceConfig *best = NULL;
+    size_t best_length = 0;
+    for (size_t i = 0; i < server->workspace_count; i++) {
+        WorkspaceConfig *ws = &server->workspaces[i];
+        size_t n = strlen(ws->path);
+        if (n > best_length && strncmp(path, ws->path, n) == 0 && path[n] == '/') {
+            best = ws;
+            best_length = n;
+        }
+    }
+    free(path);
+    if (!best) return server->fallback_config;
+
+    if (!best->loaded) {
+        size_t n = strlen(best->path);
+        char *file = malloc(n + sizeof("/.cmake_format"));
+        memcpy(file, best->path, n);
+        memcpy(file + n, "/.cmake_format", sizeof("/.cmake_format"));
+        config_init_defaults(&best->config);
+        if (!config_load_from_file(&best->config, file)) best->config = *server->fallback_config;
+        free(file);
+        best->loaded = true;
+    }
+    return &best->config;
+}
+
+// --- Documents ---
+
+static Document *find_document(Server *server, const char *uri) {
+    if (!uri) return NULL;
+    for (size_t i = 0; i < server->document_count; i++) {
+        if (strcmp(server->documents[i].uri, uri) == 0) return &server->documents[i];
+    }
+    return NULL;
+}
+
+static void free_document(Document *doc) {
+    free(doc->uri);
+    free(doc->text);
+    free_ast(doc->ast);
+    if (doc->lines_valid) line_index_free(&doc->lines);
+}
+
+static void set_document_text(Document *doc, const char *text, size_t length) {
+    if (length + 1 > doc->capacity) {
+        doc->capacity = length + 1;
+        doc->text = realloc(doc->text, doc->capacity);
+    }
+    memcpy(doc->text, text, length);
+    doc->text[length] = '\0';
+    doc->length = length;
+    free_ast(doc->ast);
+    doc->ast = parse_cmake(doc->text);
+    if (doc->lines_valid) line_index_free(&doc->lines);
+    doc->lines_valid = false;
+}
+
+static const LineIndex *document_lines(Document *doc) {
+    if (!doc->lines_valid) {
+        line_index_build(&doc->lines, doc->text, doc->length);
+        doc->lines_valid = true;
+    }
+    return &doc->lines;
+}
+
+// LSP positions count UTF-16 code units within a line.
+static SourceOffset position_to_offset(Document *doc, const JsonValue *position) {
+    const LineIndex *lines = document_lines(doc);
+    double line = json_get_number(position, "line", 0);
+    double character = json_get_number(position, "character", 0);
+    if (line < 0) return 0;
+    if ((size_t)line >= lines->line_count) return (SourceOffset)doc->length;
+
+    size_t offset = lines->line_starts[(size_t)line];
+    double units = 0;
+    while (offset < doc->length && doc->text[offset] != '\n' && units < character) {
+        unsigned char c = (unsigned char)doc->text[offset];
+        size_t width = c < 0x80 ? 1 : c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+        units += width == 4 ? 2 : 1;
+        offset += width;
+    }
+    return (SourceOffset)(offset < doc->length ? offset : doc->length);
+}
+
+static void write_position(Document *doc, FormatBuffer *out, SourceOffset offset) {
+    int line, column;
+    const LineIndex *lines = document_lines(doc);
+    line_index_lookup(lines, offset, &line, &column);
+    size_t start = lines->line_starts[line - 1];
+    long units = 0;
+    for (size_t i = start; i < offset;) {
+        unsigned char c = (unsigned char)doc->text[i];
+        size_t width = c < 0x80 ? 1 : c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+        units += width == 4 ? 2 : 1;
+        i += width;
+    }
+    json_write_raw(out, "{\"line\":");
+    json_write_int(out, line - 1);
+    json_write_raw(out, ",\"character\":");
+    json_write_int(out, units);
+    json_write_raw(out, "}");
+}
+
+static void apply_change(Document *doc, const JsonValue *change) {
+    const JsonValue *text = json_get(change, "text");
+    const JsonValue *range = json_get(change, "range");
+    if (!text || text->type != JSON_STRING) return;
+    if (!range) {
+        set_document_text(doc, text->string, text->string_length);
+        return;
+    }
+
+    SourceOffset start = position_to_offset(doc, json_get(range, "start"));
+    SourceOffset end = position_to_offset(doc, json_get(range, "end"));
+    if (end < start) end = start;
+
+    size_t new_length = doc->length - (end - start) + text->string_length;
+    if (new_length + 1 > doc->capacity) {
+        doc->capacity = (new_length + 1) * 2;
+        doc->text = realloc(doc->text, doc->capacity);
+    }
+    memmove(doc->text + start + text->string_length, doc->text + end, doc->length - end + 1);
+    memcpy(doc->text + start, text->string, text->string_length);
+    doc->length = new_length;
+
+    reparse_cmake_edit(doc->ast, doc->text, start, end, start + (SourceOffset)text->string_length);
+    if (doc->lines_valid) line_index_free(&doc->lines);
+    doc->lines_valid = false;
+}
+
+// --- Formatting ---
+
+// Formats the document and replies with TextEdit[]; edits outside
+// [range_start, range_end] are dropped unless the whole file was requested.
+static void reply_with_edits(Server *server, const JsonValue *id, Document *doc, bool whole_file,
+                             SourceOffset range_start, SourceOffset range_end) {
+    FormatBuffer formatted = {0};
+    EditList edits = {0};
+    format_ast_edits(doc->ast, doc->text, doc->length, config_for(server, doc->uri), &formatted, &edits);
+    if (!whole_file) {
+        SourceRange range = { range_start, range_end };
+        edit_list_filter_ranges(&edits, &range, 1);
+    }
+
+    FormatBuffer result = {0};
+    json_write_raw(&result, "[");
+    for (size_t i = 0; i < edits.count; i++) {
+        const TextEdit *edit = &edits.edits[i];
+        if (i > 0) json_write_raw(&result, ",");
+        json_write_raw(&result, "{\"range\":{\"start\":");
+        write_position(doc, &result, edit->offset);
+        json_write_raw(&result, ",\"end\":");
+        write_position(doc, &result, edit->offset + edit->length);
+        json_write_raw(&result, "},\"newText\":");
+        json_write_string(&result, edit->replacement, edit->replacement_length);
+        json_write_raw(&result, "}");
+    }
+    json_write_raw(&result, "]");
+    format_buffer_reserve(&result, 1);
+    result.data[result.length] = '\0';
+    send_result(server, id, result.data);
+
+    format_buffer_free(&result);
+    edit_list_free(&edits);
+    format_buffer_free(&formatted);
+}
+
+static void handle_initialize(Server *server, const JsonValue *id, const JsonValue *params) {
+    const JsonValue *folders = json_get(params, "workspaceFolders");
+    if (folders && folders->type == JSON_ARRAY) {
+        for (size_t i = 0; i < folders->count; i++) {
+            const char *uri = json_get_string(&folders->items[i], "uri");
+            if (uri) add_workspace(server, uri);
+        }
+    } else if (json_get_string(params, "rootUri")) {
+        add_workspace(server, json_get_string(params, "rootUri"));
+    }
+
+    send_result(server, id,
+                "{\"capabilities\":{"
+                "\"textDocumentSync\":{\"openClose\":true,\"change\":2},"
+                "\"documentFormattingProvider\":true,"
+                "\"documentRangeFormattingProvider\":true,"
+                "\"documentOnTypeFormattingProvider\":{\"firstTriggerCharacter\":\")\",\"moreTriggerCharacter\":[\"\\n\"]},"
+                "\"workspace\":{\"workspaceFolders\":{\"supported\":true,\"changeNotifications\":true}}"
+                "},\"serverInfo\":{\"name\":\"cmakefmt\"}}");
+}
+
+static void handle_message(Server *server, const JsonValue *message) {
+    const char *method = json_get_string(message, "method");
+    const JsonValue *id = json_get(message, "id");
+    const JsonValue *params = json_get(message, "params");
+    const JsonValue *text_document = json_get(params, "textDocument");
+    const char *uri = json_get_string(text_document, "uri");
+
+    if (!method) return; // responses to server requests are not used
+
+    if (strcmp(method, "initialize") == 0) {
+        handle_initialize(server, id, params);
+    } else if (strcmp(method, "shutdown") == 0) {
+        server->shutdown_requested = true;
+        send_result(server, id, "null");
+    } else if (strcmp(method, "textDocument/didOpen") == 0) {
+        const JsonValue *text = json_get(text_document, "text");
+        if (!uri || !text || text->type != JSON_STRING) return;
+        Document *doc = find_document(server, uri);
+        if (!doc) {
+            server->documents = realloc(server->documents, (server->document_count + 1) * sizeof(Document));
+            doc = &server->documents[server->document_count++];
+            memset(doc, 0, sizeof(*doc));
+            doc->uri = strdup(uri);
+        }
+        set_document_text(doc, text->string, text->string_length);
+    } else if (strcmp(method, "textDocument/didChange") == 0) {
+        Document *doc = find_document(server, uri);
+        const JsonValue *changes = json_get(params, "contentChanges");
+        if (!doc || !changes || changes->type != JSON_ARRAY) return;
+        for (size_t i = 0; i < changes->count; i++) apply_change(doc, &changes->items[i]);
+    } else if (strcmp(method, "textDocument/didClose") == 0) {
+        Document *doc = find_document(server, uri);
+        if (!doc) return;
+        free_document(doc);
+        *doc = server->documents[--server->document_count];
+    } else if (strcmp(method, "textDocument/formatting") == 0 ||
+               strcmp(method, "textDocument/rangeFormatting") == 0 ||
+               strcmp(method, "textDocument/onTypeFormatting") == 0) {
+        Document *doc = find_document(server, uri);
+        if (!doc) {
+            send_error(server, id, -32602, "Unknown document");
+            return;
+        }
+        if (strcmp(method, "textDocument/formatting") == 0) {
+            reply_with_edits(server, id, doc, true, 0, 0);
+        } else if (strcmp(method, "textDocument/rangeFormatting") == 0) {
+            const JsonValue *range = json_get(params, "range");
+            reply_with_edits(server, id, doc, false, position_to_offset(doc, json_get(range, "start")),
+                             position_to_offset(doc, json_get(range, "end")));
+        } else {
+            // Reformat the command that was just closed or broken: from the
+            // start of the previous line up to the cursor.
+            const JsonValue *position = json_get(params, "position");
+            SourceOffset end = position_to_offset(doc, position);
+            int line, column;
+            line_index_lookup(document_lines(doc), end, &line, &column);
+            size_t first_line = line >= 2 ? (size_t)line - 2 : 0;
+            reply_with_edits(server, id, doc, false, document_lines(doc)->line_starts[first_line], end);
+        }
+    } else if (strcmp(method, "workspace/didChangeWorkspaceFolders") == 0) {
+        const JsonValue *event = json_get(params, "event");
+        const JsonValue *added = json_get(event, "added");
+        const JsonValue *removed = json_get(event, "removed");
+        for (size_t i = 0; removed && i < removed->count; i++) {
+            const char *folder = json_get_string(&removed->items[i], "uri");
+            if (folder) remove_workspace(server, folder);
+        }
+        for (size_t i = 0; added && i < added->count; i++) {
+            const char *folder = json_get_string(&added->items[i], "uri");
+            if (folder) add_workspace(server, folder);
+        }
+    } else if (strcmp(method, "workspace/didChangeWatchedFiles") == 0) {
+        // A .cmake_format may have changed; reload configs lazily.
+        for (size_t i = 0; i < server->workspace_count; i++) server->workspaces[i].loaded = false;
+    } else if (id) {
+        send_error(server, id, -32601, "Method not found");
+    }
+}
+
+int lsp_run(FILE *in, FILE *out, const CMakeFormatConfig *fallback_config) {
+    Server server = {0};
+    server.in = in;
+    server.out = out;
+    server.fallback_config = fallback_config;
+
+    int status = 1;
+    size_t length;
+    char *body;
+    while ((body = read_message(in, &length)) != NULL) {
+        JsonValue *message = json_parse(body, length);
+        free(body);
+        if (!message) {
+            send_error(&server, NULL, -32700, "Parse error");
+            continue;
+        }
+        const char *method = json_get_string(message, "method");
+        bool exit_requested = method && strcmp(method, "exit") == 0;
+        if (!exit_requested) handle_message(&server, message);
+        json_free(message);
+        if (exit_requested) {
+            status = server.shutdown_requested ? 0 : 1;
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < server.document_count; i++) free_document(&server.documents[i]);
+    free(server.documents);
+    for (size_t i = 0; i < server.workspace_count; i++) free(server.workspaces[i].path);
+    free(server.workspaces);
+    return status;
+}
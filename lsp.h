@@ -0,0 +1,12 @@
+#ifndef LSP_H
+#define LSP_H
+
+#include "config.h"
+#include <stdio.h>
+
+// Runs a Language Server Protocol session over the given streams until the
+// client sends `exit`. Documents outside any workspace folder (or in folders
+// without a .cmake_format) use fallback_config. Returns the process exit code.
+int lsp_run(FILE *in, FILE *out, const CMakeFormatConfig *fallback_config);
+
+#endif
@@ -1,16 +1,328 @@
 #include "parser.h"
 #include "config.h"
 #include "formatter.h"
+#include "edits.h"
+#include "lsp.h"
+#include "vcs.h"
+#include "verify.h"
+#include "utf8.h"
+#include "ast_export.h"
+#include "trace.h"
+#include "sweep.h"
+#include "watch.h"
+#include "batch_io.h"
+#include "project.h"
+#include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+static void print_usage(const char *argv0) {
+    fprintf(stderr,
+            "In-place CMake reformatter.\n"
+            "Usage: %s [options] <file> ...\n"
+            "       %s --dump-config\n"
+            "       %s --sweep <config> ... -- <file> ...\n"
+            "       %s [options] --project <CMakeLists.txt>\n"
+            "\n"
+            "Options:\n"
+            "  -j, --jobs=N     Format large files on N threads\n"
+            "      --diff       Print a unified diff instead of rewriting files\n"
+            "      --io-uring   Read and write files in batches through io_uring (Linux)\n"
+            "      --dump-ast=json|binary\n"
+            "                   Print the parse of each file instead of formatting it\n"
+            "      --lsp        Run as a language server on stdin/stdout\n"
+            "      --trace-out=<file>\n"
+            "                   Write a Chrome trace of every file and phase to <file>\n"
+            "      --verify     Refuse to write output whose tokens differ from the input\n"
+            "      --watch=<dir>\n"
+            "                   Reformat CMake files under <dir> whenever they are saved\n"
+            "      --changed-since=<rev>\n"
+            "                   Only format the lines of CMake files changed since <rev>\n"
+            "      --project=<CMakeLists.txt>\n"
+            "                   Format the files the build reads, following add_subdirectory()\n"
+            "                   and include() from the given root; -j sets how many at once\n",
+            argv0, argv0, argv0, argv0);
+}
+
+typedef enum {
+    DUMP_AST_NONE,
+    DUMP_AST_JSON,
+    DUMP_AST_BINARY,
+} DumpAst;
+
+typedef struct {
+    const CMakeFormatConfig *config;
+    int jobs;
+    bool diff;
+    bool verify;
+    DumpAst dump_ast;
+    BatchIo *io;
+} Options;
+
+typedef struct {
+    const char *path;
+    const LineRange *ranges; // NULL to format the whole file
+    size_t range_count;
+} FileJob;
+
+// Files are read and written this many at a time, so that the I/O of a whole
+// batch can be in flight together.
+#define FILE_BATCH (4 * BATCH_IO_DEPTH)
+
+// Formats one file's source, given its parse. Output that should replace the
+// file is moved to `rewrite` and `changed` set; diffs and AST dumps go to
+// stdout. With line ranges, only the commands touching those lines are
+// rewritten. Returns false on failure.
+static bool process_source(const char *filename, const char *source, size_t length, ASTNode *ast,
+                           const Options *options, const LineRange *ranges, size_t range_count,
+                           FormatBuffer *rewrite, bool *changed) {
+    *changed = false;
+    size_t bad_offset;
+    if (!utf8_validate(source, length, &bad_offset)) {
+        LineIndex lines;
+        int line, column;
+        line_index_build(&lines, source, length);
+        line_index_lookup(&lines, (SourceOffset)bad_offset, &line, &column);
+        line_index_free(&lines);
+        fprintf(stderr, "%s:%d:%d: warning: invalid UTF-8\n", filename, line, column);
+    }
+
+    const BlockIndex *blocks = ast_block_index(ast);
+    if (blocks->diagnostic_count > 0) {
+        LineIndex lines;
+        line_index_build(&lines, source, length);
+        for (size_t d = 0; d < blocks->diagnostic_count; d++) {
+            const ASTNode *command = ast->children[blocks->diagnostics[d].child];
+            int line, column;
+            line_index_lookup(&lines, command->token.offset, &line, &column);
+            fprintf(stderr, "%s:%d:%d: warning: %.*s() %s\n", filename, line, column, (int)command->token.length,
+                    token_text(source, command->token), blocks->diagnostics[d].message);
+        }
+        line_index_free(&lines);
+    }
+
+    if (options->dump_ast != DUMP_AST_NONE) {
+        FormatBuffer dump = {0};
+        bool ok = true;
+        if (options->dump_ast == DUMP_AST_JSON) {
+            ast_export_json(ast, filename, source, length, &dump);
+        } else if (!ast_export_binary(ast, source, length, &dump)) {
+            fprintf(stderr, "%s: file too large for the binary AST format\n", filename);
+            ok = false;
+        }
+        fwrite(dump.data, 1, dump.length, stdout);
+        format_buffer_free(&dump);
+        return ok;
+    }
+
+    FormatBuffer formatted = {0};
+    FormatBuffer patched = {0};
+    EditList edits = {0};
+    FormatBuffer *result = &formatted;
+
+    uint64_t phase = trace_now();
+    if (!options->diff && !ranges) {
+        format_ast_parallel(ast, source, options->config, &formatted, options->jobs);
+    } else {
+        format_ast_edits(ast, source, length, options->config, &formatted, &edits);
+
+        if (ranges) {
+            LineIndex lines;
+            line_index_build(&lines, source, length);
+            SourceRange *byte_ranges = malloc((range_count + 1) * sizeof(SourceRange));
+            for (size_t r = 0; r < range_count; r++) {
+                size_t first = (size_t)ranges[r].first - 1;
+                size_t last = (size_t)ranges[r].last; // 0-based index of the following line
+                SourceOffset start = first < lines.line_count ? lines.line_starts[first] : (SourceOffset)length;
+                SourceOffset end = last < lines.line_count ? lines.line_starts[last] : (SourceOffset)length;
+                if (end > start) end--; // up to the newline of the last line
+                byte_ranges[r] = (SourceRange){ start, end < start ? start : end };
+            }
+            edit_list_filter_ranges(&edits, byte_ranges, range_count);
+            free(byte_ranges);
+            line_index_free(&lines);
+
+            apply_edits(source, length, &edits, &patched);
+            result = &patched;
+        }
+    }
+    trace_span("format", phase, filename, result->length);
+
+    bool ok = true;
+    if (options->verify) {
+        phase = trace_now();
+        format_buffer_reserve(result, 1);
+        result->data[result->length] = '\0';
+        ok = verify_formatting(filename, source, length, result->data, stderr);
+        trace_span("verify", phase, filename, length);
+    }
+
+    if (ok) {
+        if (options->diff) {
+            phase = trace_now();
+            write_unified_diff(filename, source, length, &edits, stdout);
+            trace_span("write", phase, filename, result->length);
+        } else if (result->length != length || memcmp(result->data, source, length) != 0) {
+            *rewrite = *result;
+            *result = (FormatBuffer){0};
+            *changed = true;
+        }
+    }
+
+    edit_list_free(&edits);
+    format_buffer_free(&patched);
+    format_buffer_free(&formatted);
+    return ok;
+}
+
+static void report_io_error(const char *path, int error) {
+    if (error == EFBIG) {
+        fprintf(stderr, "%s: file too large (rebuild with CMAKEFMT_LARGE_FILES)\n", path);
+    } else {
+        fprintf(stderr, "%s: %s\n", path, strerror(error));
+    }
+}
+
+// Formats each file in place (or prints its diff). Returns false if any of
+// them failed.
+static bool format_files(const FileJob *jobs, size_t count, const Options *options) {
+    bool ok = true;
+    BatchFile *reads = malloc(FILE_BATCH * sizeof(BatchFile));
+    BatchFile *writes = malloc(FILE_BATCH * sizeof(BatchFile));
+    FormatBuffer *outputs = malloc(FILE_BATCH * sizeof(FormatBuffer));
+
+    for (size_t first = 0; first < count; first += FILE_BATCH) {
+        size_t n = count - first < FILE_BATCH ? count - first : FILE_BATCH;
+        // Interned so that the spans recorded for a file need not copy it.
+        for (size_t i = 0; i < n; i++) reads[i].path = trace_path(jobs[first + i].path);
+        // Files share the batched read and write, so each "file" span runs
+        // from the start of the one to the end of the other.
+        uint64_t batch_start = trace_now();
+        batch_io_read(options->io, reads, n, SOURCE_OFFSET_MAX);
+
+        size_t write_count = 0;
+        for (size_t i = 0; i < n; i++) {
+            const FileJob *job = &jobs[first + i];
+            if (!reads[i].data) {
+                report_io_error(job->path, reads[i].error);
+                ok = false;
+                continue;
+            }
+            uint64_t start = trace_now();
+            ASTNode *ast = parse_cmake(reads[i].data);
+            trace_span("parse", start, reads[i].path, reads[i].length);
+            bool changed;
+            outputs[write_count] = (FormatBuffer){0};
+            if (!process_source(reads[i].path, reads[i].data, reads[i].length, ast, options, job->ranges,
+                                job->range_count, &outputs[write_count], &changed)) {
+                ok = false;
+            }
+            free_ast(ast);
+            if (changed) {
+                writes[write_count] = (BatchFile){ reads[i].path, outputs[write_count].data, outputs[write_count].length, 0 };
+                write_count++;
+            }
+            free(reads[i].data);
+        }
+
+        batch_io_write(options->io, writes, write_count);
+        for (size_t i = 0; i < write_count; i++) {
+            if (writes[i].error) {
+                report_io_error(writes[i].path, writes[i].error);
+                ok = false;
+            }
+            format_buffer_free(&outputs[i]);
+        }
+        for (size_t i = 0; i < n; i++) trace_span("file", batch_start, reads[i].path, reads[i].length);
+    }
+
+    free(outputs);
+    free(writes);
+    free(reads);
+    return ok;
+}
+
+typedef struct {
+    const Options *options;
+    pthread_mutex_t output_lock;
+} ProjectContext;
+
+// Runs on project_run's workers. Each file is formatted on the worker that
+// parsed it, so the files themselves are the unit of parallelism; diffs and
+// dumps are printed one file at a time.
+static bool format_project_file(const char *path, const char *source, size_t length, ASTNode *ast,
+                                void *context) {
+    ProjectContext *project = context;
+    bool to_stdout = project->options->diff || project->options->dump_ast != DUMP_AST_NONE;
+    FormatBuffer output = {0};
+    bool changed;
+
+    if (to_stdout) pthread_mutex_lock(&project->output_lock);
+    bool ok = process_source(path, source, length, ast, project->options, NULL, 0, &output, &changed);
+    if (to_stdout) pthread_mutex_unlock(&project->output_lock);
+
+    if (changed) {
+        BatchIo *io = batch_io_open(false);
+        BatchFile file = { path, output.data, output.length, 0 };
+        batch_io_write(io, &file, 1);
+        batch_io_close(io);
+        if (file.error) {
+            report_io_error(path, file.error);
+            ok = false;
+        }
+    }
+    format_buffer_free(&output);
+    return ok;
+}
+
+typedef struct {
+    const Options *options;
+    CMakeFormatConfig *config;
+} WatchContext;
+
+static double elapsed_ms(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) * 1e3 + (double)(now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static bool same_file(const char *a, const char *b) {
+    struct stat sa, sb;
+    return stat(a, &sa) == 0 && stat(b, &sb) == 0 && sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+}
+
+// The config and everything else stay loaded between saves; only an edit of
+// the .cmake_format in use reloads it.
+static void watch_changed(const char *path, void *context) {
+    WatchContext *watch = context;
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    if (strcmp(base, ".cmake_format") == 0) {
+        if (same_file(path, ".cmake_format")) {
+            config_init_defaults(watch->config);
+            config_load_from_file(watch->config, ".cmake_format");
+            fprintf(stderr, "%s: reloaded\n", path);
+        }
+        return;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    FileJob job = { path, NULL, 0 };
+    bool ok = format_files(&job, 1, watch->options);
+    fprintf(stderr, "%s: %s in %.2f ms\n", path, ok ? "formatted" : "failed", elapsed_ms(&start));
+}
 
 int main(int argc, char **argv) {
     if (argc < 2 || strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-h") == 0) {
-        fprintf(stderr, "In-place CMake reformatter.\nUsage: %s <file> ...\n       %s --dump-config\n", argv[0], argv[0]);
+        print_usage(argv[0]);
         return (argc < 2) ? 1 : 0;
     }
-    
+
     CMakeFormatConfig config;
     config_init_defaults(&config);
     config_load_from_file(&config, ".cmake_format");
@@ -19,38 +331,111 @@ int main(int argc, char **argv) {
         config_dump(&config, stdout);
         return 0;
     }
-    
-    for (int i = 1; i < argc; i++) {
-        const char *filename = argv[i];
-        
-        FILE *f = fopen(filename, "rb");
-        if (!f) {
-            perror("fopen");
-            continue;
-        }
-        
-        fseek(f, 0, SEEK_END);
-        long length = ftell(f);
-        fseek(f, 0, SEEK_SET);
-        
-        char *source = malloc(length + 1);
-        fread(source, 1, length, f);
-        source[length] = '\0';
-        fclose(f);
-        
-        ASTNode *ast = parse_cmake(source);
-        
-        FILE *out = fopen(filename, "wb");
-        if (out) {
-            format_ast(ast, &config, out);
-            fclose(out);
+
+    if (strcmp(argv[1], "--lsp") == 0) {
+        return lsp_run(stdin, stdout, &config);
+    }
+
+    if (strcmp(argv[1], "--sweep") == 0) {
+        int separator = 2;
+        while (separator < argc && strcmp(argv[separator], "--") != 0) separator++;
+        if (separator == 2 || separator >= argc - 1) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        bool ok = sweep_run((const char *const *)argv + 2, (size_t)(separator - 2),
+                            (const char *const *)argv + separator + 1, (size_t)(argc - separator - 1), stdout);
+        return ok ? 0 : 1;
+    }
+
+    Options options = { &config, 1, false, false, DUMP_AST_NONE, NULL };
+    const char *changed_since = NULL;
+    const char *trace_out = NULL;
+    const char *watch_dir = NULL;
+    const char *project_root = NULL;
+    bool io_uring = false;
+    int first_file = 1;
+    while (first_file < argc && argv[first_file][0] == '-') {
+        const char *arg = argv[first_file];
+        if (strcmp(arg, "--") == 0) {
+            first_file++;
+            break;
+        } else if (strcmp(arg, "--diff") == 0) {
+            options.diff = true;
+        } else if (strcmp(arg, "--dump-ast=json") == 0) {
+            options.dump_ast = DUMP_AST_JSON;
+        } else if (strcmp(arg, "--dump-ast=binary") == 0) {
+            options.dump_ast = DUMP_AST_BINARY;
+        } else if (strcmp(arg, "--io-uring") == 0) {
+            io_uring = true;
+        } else if (strcmp(arg, "--verify") == 0) {
+            options.verify = true;
+        } else if (strncmp(arg, "--trace-out=", 12) == 0) {
+            trace_out = arg + 12;
+        } else if (strcmp(arg, "--watch") == 0 && first_file + 1 < argc) {
+            watch_dir = argv[++first_file];
+        } else if (strncmp(arg, "--watch=", 8) == 0) {
+            watch_dir = arg + 8;
+        } else if (strcmp(arg, "--project") == 0 && first_file + 1 < argc) {
+            project_root = argv[++first_file];
+        } else if (strncmp(arg, "--project=", 10) == 0) {
+            project_root = arg + 10;
+        } else if (strncmp(arg, "--changed-since=", 16) == 0) {
+            changed_since = arg + 16;
+        } else if ((strcmp(arg, "-j") == 0 || strcmp(arg, "--jobs") == 0) && first_file + 1 < argc) {
+            options.jobs = atoi(argv[++first_file]);
+        } else if (strncmp(arg, "--jobs=", 7) == 0) {
+            options.jobs = atoi(arg + 7);
+        } else if (strncmp(arg, "-j", 2) == 0 && arg[2] != '\0') {
+            options.jobs = atoi(arg + 2);
         } else {
-            perror("fopen write");
+            fprintf(stderr, "Unknown option: %s\n", arg);
+            print_usage(argv[0]);
+            return 1;
+        }
+        first_file++;
+    }
+    if (options.jobs < 1) options.jobs = 1;
+    if (trace_out) trace_enable();
+    // io_uring stays opt-in: with warm caches it measured slower than the
+    // blocking path.
+    options.io = batch_io_open(io_uring);
+
+    int status = 0;
+    if (watch_dir) {
+        WatchContext watch = { &options, &config };
+        fprintf(stderr, "Watching %s for changes\n", watch_dir);
+        if (!watch_run(watch_dir, 50, watch_changed, &watch)) status = 1;
+    } else if (project_root) {
+        Options per_file = options;
+        per_file.jobs = 1;
+        ProjectContext project = { &per_file, PTHREAD_MUTEX_INITIALIZER };
+        if (!project_run(project_root, options.jobs, format_project_file, &project)) status = 1;
+    } else if (changed_since) {
+        ChangedFileList changed;
+        if (!vcs_changed_files(changed_since, &changed)) {
+            fprintf(stderr, "Could not list changes since %s\n", changed_since);
+            return 1;
+        }
+        FileJob *jobs = malloc((changed.count + 1) * sizeof(FileJob));
+        for (size_t i = 0; i < changed.count; i++) {
+            jobs[i] = (FileJob){ changed.files[i].path, changed.files[i].ranges, changed.files[i].range_count };
         }
-        
-        free_ast(ast);
-        free(source);
+        if (!format_files(jobs, changed.count, &options)) status = 1;
+        free(jobs);
+        vcs_changed_files_free(&changed);
+    } else {
+        size_t count = (size_t)(argc - first_file);
+        FileJob *jobs = malloc((count + 1) * sizeof(FileJob));
+        for (size_t i = 0; i < count; i++) jobs[i] = (FileJob){ argv[first_file + i], NULL, 0 };
+        if (!format_files(jobs, count, &options)) status = 1;
+        free(jobs);
+    }
+    batch_io_close(options.io);
+
+    if (trace_out && !trace_write(trace_out)) {
+        fprintf(stderr, "Could not write trace to %s\n", trace_out);
+        status = 1;
     }
-    
-    return 0;
+    return status;
 }
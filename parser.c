@@ -1,6 +1,9 @@
 #include "parser.h"
+#include "utf8.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <strings.h>
 
 static ASTNode *create_node(NodeType type, Token token) {
     ASTNode *node = calloc(1, sizeof(ASTNode));
@@ -9,6 +12,23 @@ static ASTNode *create_node(NodeType type, Token token) {
     return node;
 }
 
+// The root carries the block index next to it, so other nodes stay as small
+// as they are.
+typedef struct {
+    ASTNode node; // first, so the root is handed out and freed as an ASTNode
+    BlockIndex blocks;
+} FileNode;
+
+static ASTNode *create_file_node(void) {
+    FileNode *file = calloc(1, sizeof(FileNode));
+    file->node.type = NODE_FILE;
+    return &file->node;
+}
+
+const BlockIndex *ast_block_index(const ASTNode *root) {
+    return &((const FileNode *)root)->blocks;
+}
+
 static void add_child(ASTNode *parent, ASTNode *child) {
     if (parent->child_count == parent->child_capacity) {
         parent->child_capacity = parent->child_capacity == 0 ? 8 : parent->child_capacity * 2;
@@ -23,49 +43,88 @@ void free_ast(ASTNode *node) {
         free_ast(node->children[i]);
     }
     free(node->children);
+    if (node->type == NODE_FILE) {
+        FileNode *file = (FileNode *)node;
+        free(file->blocks.entries);
+        free(file->blocks.diagnostics);
+    }
     free(node);
 }
 
+SourceOffset ast_node_end(const ASTNode *node) {
+    while (node->child_count > 0) {
+        node = node->children[node->child_count - 1];
+    }
+    return node->token.offset + node->token.length;
+}
+
 typedef struct {
     Lexer lexer;
     Token current;
     Token previous;
 } Parser;
 
+// Leaf node for the current token, preceded by `leading` whitespace. Only
+// tokens that can hold arbitrary text pay for the display-width scan; parens
+// are ASCII.
+static ASTNode *create_token_node(Parser *parser, NodeType type, Trivia leading) {
+    ASTNode *node = create_node(type, parser->current);
+    node->leading = leading;
+    if (type == NODE_LPAREN || type == NODE_RPAREN) {
+        node->width = node->token.length;
+    } else {
+        node->width = (SourceOffset)utf8_display_width(token_text(parser->lexer.source, node->token),
+                                                      node->token.length);
+    }
+    return node;
+}
+
 static void advance_parser(Parser *parser) {
     parser->previous = parser->current;
     parser->current = lexer_next_token(&parser->lexer);
 }
 
-static bool match_parser(Parser *parser, TokenType type) {
-    if (parser->current.type == type) {
+// Consumes a run of whitespace tokens and returns it as counts.
+static Trivia parse_trivia(Parser *parser) {
+    Trivia trivia = { 0, 0 };
+    for (;;) {
+        if (parser->current.type == TOKEN_SPACE) {
+            trivia.spaces += (uint32_t)parser->current.length;
+        } else if (parser->current.type == TOKEN_NEWLINE) {
+            trivia.newlines++;
+        } else {
+            return trivia;
+        }
         advance_parser(parser);
-        return true;
     }
-    return false;
 }
 
-static void parse_arguments(Parser *parser, ASTNode *cmd_node, int paren_depth) {
-    while (parser->current.type != TOKEN_EOF) {
+// Parses the arguments after a command's opening paren, up to and including
+// its matching closing paren. Nested parens become flat children of the
+// command, so the only state each nesting level needs is its depth and the
+// explicit stack reduces to a counter: depth is bounded by memory, never by
+// the C stack.
+static void parse_arguments(Parser *parser, ASTNode *cmd_node) {
+    size_t paren_depth = 0;
+    for (;;) {
+        Trivia leading = parse_trivia(parser);
+        if (parser->current.type == TOKEN_EOF) {
+            cmd_node->trailing = leading;
+            return;
+        }
+
         if (parser->current.type == TOKEN_RPAREN) {
-            if (paren_depth > 0) {
-                return; // Let the caller consume the RPAREN
-            } else {
-                // If depth is 0, this is the closing RPAREN for the command invocation
-                add_child(cmd_node, create_node(NODE_RPAREN, parser->current));
-                advance_parser(parser);
-                return;
-            }
+            add_child(cmd_node, create_token_node(parser, NODE_RPAREN, leading));
+            advance_parser(parser);
+            if (paren_depth == 0) return; // closes the command invocation
+            paren_depth--;
+            continue;
         }
 
         if (parser->current.type == TOKEN_LPAREN) {
-            add_child(cmd_node, create_node(NODE_LPAREN, parser->current));
+            add_child(cmd_node, create_token_node(parser, NODE_LPAREN, leading));
             advance_parser(parser);
-            parse_arguments(parser, cmd_node, paren_depth + 1);
-            if (parser->current.type == TOKEN_RPAREN) {
-                add_child(cmd_node, create_node(NODE_RPAREN, parser->current));
-                advance_parser(parser);
-            }
+            paren_depth++;
             continue;
         }
 
@@ -74,45 +133,196 @@ static void parse_arguments(Parser *parser, ASTNode *cmd_node, int paren_depth)
             case TOKEN_UNQUOTED_ARGUMENT: type = NODE_UNQUOTED_ARGUMENT; break;
             case TOKEN_QUOTED_ARGUMENT: type = NODE_QUOTED_ARGUMENT; break;
             case TOKEN_BRACKET_ARGUMENT: type = NODE_BRACKET_ARGUMENT; break;
-            case TOKEN_SPACE: type = NODE_SPACE; break;
-            case TOKEN_NEWLINE: type = NODE_NEWLINE; break;
             case TOKEN_LINE_COMMENT: type = NODE_LINE_COMMENT; break;
             case TOKEN_BRACKET_COMMENT: type = NODE_BRACKET_COMMENT; break;
             default: type = NODE_UNQUOTED_ARGUMENT; break;
         }
-        add_child(cmd_node, create_node(type, parser->current));
+        add_child(cmd_node, create_token_node(parser, type, leading));
         advance_parser(parser);
     }
 }
 
-static ASTNode *parse_command_invocation(Parser *parser) {
+static ASTNode *parse_command_invocation(Parser *parser, Trivia leading) {
     ASTNode *cmd_node = create_node(NODE_COMMAND_INVOCATION, parser->current);
-    
-    ASTNode *id_node = create_node(NODE_IDENTIFIER, parser->current);
+    cmd_node->leading = leading;
+
+    ASTNode *id_node = create_token_node(parser, NODE_IDENTIFIER, (Trivia){ 0, 0 });
     add_child(cmd_node, id_node);
     advance_parser(parser);
 
-    while (parser->current.type == TOKEN_SPACE || parser->current.type == TOKEN_NEWLINE ||
-           parser->current.type == TOKEN_LINE_COMMENT || parser->current.type == TOKEN_BRACKET_COMMENT) {
-        NodeType type = NODE_SPACE;
-        if (parser->current.type == TOKEN_NEWLINE) type = NODE_NEWLINE;
-        if (parser->current.type == TOKEN_LINE_COMMENT) type = NODE_LINE_COMMENT;
-        if (parser->current.type == TOKEN_BRACKET_COMMENT) type = NODE_BRACKET_COMMENT;
-        
-        add_child(cmd_node, create_node(type, parser->current));
-        advance_parser(parser);
+    for (;;) {
+        Trivia before = parse_trivia(parser);
+        if (parser->current.type == TOKEN_LINE_COMMENT || parser->current.type == TOKEN_BRACKET_COMMENT) {
+            NodeType type = parser->current.type == TOKEN_LINE_COMMENT ? NODE_LINE_COMMENT : NODE_BRACKET_COMMENT;
+            add_child(cmd_node, create_token_node(parser, type, before));
+            advance_parser(parser);
+        } else if (parser->current.type == TOKEN_LPAREN) {
+            add_child(cmd_node, create_token_node(parser, NODE_LPAREN, before));
+            advance_parser(parser);
+            break;
+        } else {
+            // No argument list: the whitespace read ahead stays with the command.
+            cmd_node->trailing = before;
+            return cmd_node;
+        }
     }
 
-    if (parser->current.type == TOKEN_LPAREN) {
-        add_child(cmd_node, create_node(NODE_LPAREN, parser->current));
+    parse_arguments(parser, cmd_node);
+
+    return cmd_node;
+}
+
+// Parses the significant node at the current token, which follows `leading`.
+static ASTNode *parse_top_level_node(Parser *parser, Trivia leading) {
+    ASTNode *node;
+    if (parser->current.type == TOKEN_LINE_COMMENT) {
+        node = create_token_node(parser, NODE_LINE_COMMENT, leading);
+        advance_parser(parser);
+    } else if (parser->current.type == TOKEN_BRACKET_COMMENT) {
+        node = create_token_node(parser, NODE_BRACKET_COMMENT, leading);
         advance_parser(parser);
+    } else if (parser->current.type == TOKEN_UNQUOTED_ARGUMENT) {
+        // Unquoted argument at top level could be an identifier
+        node = parse_command_invocation(parser, leading);
     } else {
-        return cmd_node;
+        // Fallback: treat as unquoted?
+        node = create_token_node(parser, NODE_UNQUOTED_ARGUMENT, leading);
+        advance_parser(parser);
     }
+    return node;
+}
 
-    parse_arguments(parser, cmd_node, 0);
+typedef enum {
+    BLOCK_COMMAND_NONE,
+    BLOCK_COMMAND_OPEN,
+    BLOCK_COMMAND_ELSE,  // else() and elseif()
+    BLOCK_COMMAND_CLOSE,
+} BlockRole;
 
-    return cmd_node;
+typedef enum {
+    BLOCK_IF,
+    BLOCK_WHILE,
+    BLOCK_FOREACH,
+    BLOCK_FUNCTION,
+    BLOCK_MACRO,
+    BLOCK_BLOCK,
+} BlockKind;
+
+static const struct {
+    const char *open;
+    const char *close;
+} block_commands[] = {
+    [BLOCK_IF] = { "if", "endif" },
+    [BLOCK_WHILE] = { "while", "endwhile" },
+    [BLOCK_FOREACH] = { "foreach", "endforeach" },
+    [BLOCK_FUNCTION] = { "function", "endfunction" },
+    [BLOCK_MACRO] = { "macro", "endmacro" },
+    [BLOCK_BLOCK] = { "block", "endblock" },
+};
+
+static bool name_is(const char *name, size_t len, const char *word) {
+    return strlen(word) == len && strncasecmp(name, word, len) == 0;
+}
+
+static BlockRole block_role(const ASTNode *command, const char *source, BlockKind *kind) {
+    if (command->type != NODE_COMMAND_INVOCATION || command->child_count == 0 ||
+        command->children[0]->type != NODE_IDENTIFIER) {
+        return BLOCK_COMMAND_NONE;
+    }
+    const char *name = token_text(source, command->children[0]->token);
+    size_t len = command->children[0]->token.length;
+    if (name_is(name, len, "else") || name_is(name, len, "elseif")) {
+        *kind = BLOCK_IF;
+        return BLOCK_COMMAND_ELSE;
+    }
+    for (size_t k = 0; k < sizeof(block_commands) / sizeof(block_commands[0]); k++) {
+        *kind = (BlockKind)k;
+        if (name_is(name, len, block_commands[k].open)) return BLOCK_COMMAND_OPEN;
+        if (name_is(name, len, block_commands[k].close)) return BLOCK_COMMAND_CLOSE;
+    }
+    return BLOCK_COMMAND_NONE;
+}
+
+static void add_block_diagnostic(BlockIndex *index, size_t child, const char *message) {
+    index->diagnostics = realloc(index->diagnostics, (index->diagnostic_count + 1) * sizeof(BlockDiagnostic));
+    index->diagnostics[index->diagnostic_count++] = (BlockDiagnostic){ child, message };
+}
+
+typedef struct {
+    size_t child;
+    BlockKind kind;
+} OpenBlock;
+
+typedef struct {
+    size_t child;
+    size_t height; // of the block stack while the block it continues is innermost
+} PendingElse;
+
+// One pass over the top-level children with a stack of the open blocks.
+// Unbalanced input is indexed the way it is indented: a closer or else()
+// applies to the innermost open block whatever its kind, and a closer with
+// none open stays at depth 0.
+static void build_block_index(FileNode *file, const char *source) {
+    ASTNode *root = &file->node;
+    BlockIndex *index = &file->blocks;
+    free(index->diagnostics);
+    index->diagnostics = NULL;
+    index->diagnostic_count = 0;
+    index->entries = realloc(index->entries, (root->child_count + 1) * sizeof(BlockEntry));
+
+    OpenBlock *open = NULL;
+    size_t open_count = 0, open_capacity = 0;
+    PendingElse *elses = NULL; // waiting for their block's closer
+    size_t else_count = 0, else_capacity = 0;
+
+    for (size_t i = 0; i < root->child_count; i++) {
+        BlockEntry *entry = &index->entries[i];
+        *entry = (BlockEntry){ (int)open_count, BLOCK_NONE, BLOCK_NONE };
+        BlockKind kind;
+        switch (block_role(root->children[i], source, &kind)) {
+        case BLOCK_COMMAND_OPEN:
+            if (open_count == open_capacity) {
+                open_capacity = open_capacity ? open_capacity * 2 : 16;
+                open = realloc(open, open_capacity * sizeof(OpenBlock));
+            }
+            open[open_count++] = (OpenBlock){ i, kind };
+            break;
+        case BLOCK_COMMAND_ELSE:
+            if (open_count == 0) {
+                add_block_diagnostic(index, i, "is outside an if() block");
+                break;
+            }
+            if (open[open_count - 1].kind != BLOCK_IF) add_block_diagnostic(index, i, "is outside an if() block");
+            entry->depth = (int)open_count - 1;
+            entry->opener = open[open_count - 1].child;
+            if (else_count == else_capacity) {
+                else_capacity = else_capacity ? else_capacity * 2 : 16;
+                elses = realloc(elses, else_capacity * sizeof(PendingElse));
+            }
+            elses[else_count++] = (PendingElse){ i, open_count };
+            break;
+        case BLOCK_COMMAND_CLOSE:
+            if (open_count == 0) {
+                add_block_diagnostic(index, i, "closes no open block");
+                break;
+            }
+            if (open[open_count - 1].kind != kind) add_block_diagnostic(index, i, "does not match the open block");
+            while (else_count > 0 && elses[else_count - 1].height == open_count) {
+                index->entries[elses[--else_count].child].closer = i;
+            }
+            open_count--;
+            entry->depth = (int)open_count;
+            entry->opener = open[open_count].child;
+            index->entries[entry->opener].closer = i;
+            break;
+        case BLOCK_COMMAND_NONE:
+            break;
+        }
+    }
+    for (size_t b = 0; b < open_count; b++) add_block_diagnostic(index, open[b].child, "is never closed");
+
+    free(elses);
+    free(open);
 }
 
 ASTNode *parse_cmake(const char *source) {
@@ -120,48 +330,123 @@ ASTNode *parse_cmake(const char *source) {
     lexer_init(&parser.lexer, source);
     advance_parser(&parser);
 
-    ASTNode *file_node = create_node(NODE_FILE, (Token){0});
-
-    while (parser.current.type != TOKEN_EOF) {
-        if (parser.current.type == TOKEN_SPACE) {
-            add_child(file_node, create_node(NODE_SPACE, parser.current));
-            advance_parser(&parser);
-        } else if (parser.current.type == TOKEN_NEWLINE) {
-            add_child(file_node, create_node(NODE_NEWLINE, parser.current));
-            advance_parser(&parser);
-        } else if (parser.current.type == TOKEN_LINE_COMMENT) {
-            add_child(file_node, create_node(NODE_LINE_COMMENT, parser.current));
-            advance_parser(&parser);
-        } else if (parser.current.type == TOKEN_BRACKET_COMMENT) {
-            add_child(file_node, create_node(NODE_BRACKET_COMMENT, parser.current));
-            advance_parser(&parser);
-        } else if (parser.current.type == TOKEN_UNQUOTED_ARGUMENT) {
-            // Unquoted argument at top level could be an identifier
-            add_child(file_node, parse_command_invocation(&parser));
-        } else {
-            // Fallback: treat as unquoted?
-            add_child(file_node, create_node(NODE_UNQUOTED_ARGUMENT, parser.current));
-            advance_parser(&parser);
+    ASTNode *file_node = create_file_node();
+
+    for (;;) {
+        Trivia leading = parse_trivia(&parser);
+        if (parser.current.type == TOKEN_EOF) {
+            file_node->trailing = leading;
+            break;
         }
+        add_child(file_node, parse_top_level_node(&parser, leading));
     }
 
+    build_block_index((FileNode *)file_node, source);
     return file_node;
 }
 
-void print_ast(ASTNode *node, int depth) {
+static void shift_offsets(ASTNode *node, SourceOffset delta) {
+    node->token.offset += delta;
+    for (size_t i = 0; i < node->child_count; i++) {
+        shift_offsets(node->children[i], delta);
+    }
+}
+
+// Only commands that ran into EOF or found no '(' carry trailing whitespace.
+static bool is_unterminated_command(const ASTNode *node) {
+    return node->type == NODE_COMMAND_INVOCATION &&
+           (node->trailing.newlines > 0 || node->trailing.spaces > 0 ||
+            node->children[node->child_count - 1]->type != NODE_RPAREN);
+}
+
+size_t reparse_cmake_edit(ASTNode *root, const char *source, SourceOffset edit_start,
+                          SourceOffset edit_old_end, SourceOffset edit_new_end) {
+    // Offsets are unsigned; the wrap-around of a negative delta cancels out.
+    SourceOffset delta = edit_new_end - edit_old_end;
+    ASTNode **old = root->children;
+    size_t old_count = root->child_count;
+
+    // First child that ends at or after the edit: a token right before the
+    // edit may grow into it (e.g. a comment or argument being extended).
+    size_t first = 0;
+    while (first < old_count && ast_node_end(old[first]) < edit_start) first++;
+    // A command without a closing paren stopped at a lookahead token, and
+    // the edit may change what that lookahead is.
+    while (first > 0 && is_unterminated_command(old[first - 1])) first--;
+    // Re-lex from the end of the last kept node so the whitespace in front of
+    // old[first] is read again as well.
+    SourceOffset start = first > 0 ? ast_node_end(old[first - 1]) : 0;
+
+    Parser parser;
+    lexer_init(&parser.lexer, source);
+    parser.lexer.current = source + start;
+    advance_parser(&parser);
+
+    ASTNode *fresh = create_node(NODE_FILE, (Token){0});
+    size_t sync = first; // candidate old child to resume at
+    for (;;) {
+        Trivia leading = parse_trivia(&parser);
+        SourceOffset position = parser.current.offset;
+        if (position >= edit_new_end) {
+            // Everything from an old child boundary past the edit onwards is
+            // byte-identical to before, so the old nodes can be reused; only
+            // the whitespace in front of the first one may have changed.
+            while (sync < old_count &&
+                   (old[sync]->token.offset < edit_old_end || old[sync]->token.offset + delta < position)) {
+                sync++;
+            }
+            if (sync < old_count && old[sync]->token.offset + delta == position) {
+                old[sync]->leading = leading;
+                break;
+            }
+        }
+        if (parser.current.type == TOKEN_EOF) {
+            root->trailing = leading;
+            sync = old_count;
+            break;
+        }
+        add_child(fresh, parse_top_level_node(&parser, leading));
+    }
+
+    for (size_t i = first; i < sync; i++) free_ast(old[i]);
+    for (size_t i = sync; i < old_count; i++) shift_offsets(old[i], delta);
+
+    size_t new_count = first + fresh->child_count + (old_count - sync);
+    ASTNode **children = malloc((new_count > 0 ? new_count : 1) * sizeof(ASTNode *));
+    // old and fresh->children are NULL when empty, which memcpy may not see.
+    if (first > 0) memcpy(children, old, first * sizeof(ASTNode *));
+    if (fresh->child_count > 0) memcpy(children + first, fresh->children, fresh->child_count * sizeof(ASTNode *));
+    if (sync < old_count) {
+        memcpy(children + first + fresh->child_count, old + sync, (old_count - sync) * sizeof(ASTNode *));
+    }
+
+    size_t reparsed = fresh->child_count;
+    free(fresh->children);
+    free(fresh);
+    free(root->children);
+    root->children = children;
+    root->child_count = new_count;
+    root->child_capacity = new_count > 0 ? new_count : 1;
+    build_block_index((FileNode *)root, source);
+    return reparsed;
+}
+
+void print_ast(ASTNode *node, const char *source, int depth) {
     for (int i = 0; i < depth; i++) printf("  ");
     const char *names[] = {
         "NODE_FILE", "NODE_COMMAND_INVOCATION", "NODE_IDENTIFIER",
         "NODE_UNQUOTED_ARGUMENT", "NODE_QUOTED_ARGUMENT", "NODE_BRACKET_ARGUMENT",
-        "NODE_LINE_COMMENT", "NODE_BRACKET_COMMENT", "NODE_SPACE", "NODE_NEWLINE",
-        "NODE_LPAREN", "NODE_RPAREN"
+        "NODE_LINE_COMMENT", "NODE_BRACKET_COMMENT", "NODE_LPAREN", "NODE_RPAREN"
     };
     printf("%s", names[node->type]);
+    if (node->leading.newlines || node->leading.spaces) {
+        printf(" [%u newlines, %u spaces before]", node->leading.newlines, node->leading.spaces);
+    }
     if (node->token.length > 0) {
-        printf(" '%.*s'", (int)node->token.length, node->token.start);
+        printf(" '%.*s'", (int)node->token.length, token_text(source, node->token));
     }
     printf("\n");
     for (size_t i = 0; i < node->child_count; i++) {
-        print_ast(node->children[i], depth + 1);
+        print_ast(node->children[i], source, depth + 1);
     }
 }
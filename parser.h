@@ -13,22 +13,66 @@ typedef enum {
     NODE_BRACKET_ARGUMENT,
     NODE_LINE_COMMENT,
     NODE_BRACKET_COMMENT,
-    NODE_SPACE,
-    NODE_NEWLINE,
     NODE_LPAREN,
     NODE_RPAREN,
 } NodeType;
 
+// Whitespace between two nodes. Spaces and newlines are not nodes of their
+// own; each node records the run in front of it as counts.
+typedef struct {
+    uint32_t newlines; // newline tokens (LF or CRLF)
+    uint32_t spaces;   // bytes of spaces and tabs
+} Trivia;
+
 typedef struct ASTNode {
     NodeType type;
     Token token;
+    SourceOffset width; // display columns of the token text, see utf8.h
+    Trivia leading;     // whitespace before this node
+    Trivia trailing;    // whitespace after the last child (file and commands)
     struct ASTNode **children;
     size_t child_count;
     size_t child_capacity;
 } ASTNode;
 
+// Block structure of the top-level children. if/elseif/else/endif, foreach,
+// while, function, macro and block commands open and close blocks; the index
+// records where each child sits in them, so its indentation is a lookup
+// instead of a replay of everything before it.
+#define BLOCK_NONE SIZE_MAX
+
+typedef struct {
+    int depth;     // indentation level; a block's opener, else() and closer share one
+    size_t opener; // else/elseif/closers: the command opening the block, else BLOCK_NONE
+    size_t closer; // openers and else/elseif: the command closing the block, else BLOCK_NONE
+} BlockEntry;
+
+typedef struct {
+    size_t child;        // top-level child the problem is reported at
+    const char *message; // follows the command name, e.g. "closes no open block"
+} BlockDiagnostic;
+
+typedef struct {
+    BlockEntry *entries; // one per top-level child
+    BlockDiagnostic *diagnostics;
+    size_t diagnostic_count;
+} BlockIndex;
+
+// Parses a whole file and builds its block index.
 ASTNode *parse_cmake(const char *source);
+// The block index of a root returned by parse_cmake.
+const BlockIndex *ast_block_index(const ASTNode *root);
+// Updates the top-level children of `root` after the old source bytes
+// [edit_start, edit_old_end) were replaced; `source` is the new text, where
+// the replacement spans [edit_start, edit_new_end). Only the commands the
+// edit touches are re-parsed, the rest keep their nodes with shifted offsets.
+// The block index is rebuilt. Returns the number of top-level nodes that were
+// re-parsed.
+size_t reparse_cmake_edit(ASTNode *root, const char *source, SourceOffset edit_start,
+                          SourceOffset edit_old_end, SourceOffset edit_new_end);
 void free_ast(ASTNode *node);
-void print_ast(ASTNode *node, int depth);
+// Offset one past the last source byte covered by the node.
+SourceOffset ast_node_end(const ASTNode *node);
+void print_ast(ASTNode *node, const char *source, int depth);
 
 #endif
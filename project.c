@@ -0,0 +1,479 @@
+#include "project.h"
+#include "batch_io.h"
+#include "trace.h"
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+// Paths are kept absolute and canonical inside; only what is shown to the
+// user and the handler is made relative to the working directory again.
+
+typedef struct ProjectJob {
+    char *path;       // for messages and the handler
+    char *file;       // canonical
+    char *source_dir; // CMAKE_CURRENT_SOURCE_DIR while the file runs
+    char **module_path;
+    size_t module_count;
+    struct ProjectJob *next;
+} ProjectJob;
+
+typedef struct {
+    char cwd[PATH_MAX];
+    const char *root_dir;
+    ProjectFileHandler handler;
+    void *context;
+
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    ProjectJob *head, *tail;
+    int busy; // workers on a file, which may still queue more
+    bool ok;
+    char **visited; // open-addressed set of canonical paths
+    size_t visited_count, visited_capacity;
+} Project;
+
+static char *copy_text(const char *text, size_t length) {
+    char *copy = malloc(length + 1);
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+// `name` relative to `dir`, or `name` itself when absolute.
+static char *join_path(const char *dir, const char *name) {
+    if (name[0] == '/') return strdup(name);
+    size_t a = strlen(dir), b = strlen(name);
+    char *path = malloc(a + b + 2);
+    memcpy(path, dir, a);
+    path[a] = '/';
+    memcpy(path + a + 1, name, b + 1);
+    return path;
+}
+
+static char *dir_name(const char *path) {
+    const char *slash = strrchr(path, '/');
+    if (!slash) return strdup(".");
+    if (slash == path) return strdup("/");
+    return copy_text(path, (size_t)(slash - path));
+}
+
+// `file` relative to the working directory when it lies below it.
+static char *display_path(const Project *project, const char *file) {
+    size_t n = strlen(project->cwd);
+    if (strncmp(file, project->cwd, n) == 0 && file[n] == '/') return strdup(file + n + 1);
+    return strdup(file);
+}
+
+static uint64_t hash_path(const char *path) {
+    uint64_t hash = 14695981039346656037ull;
+    for (; *path; path++) hash = (hash ^ (unsigned char)*path) * 1099511628211ull;
+    return hash;
+}
+
+// Adds `path` to the visited set; false if it was there already. Called with
+// the lock held.
+static bool mark_visited(Project *project, const char *path) {
+    if ((project->visited_count + 1) * 2 > project->visited_capacity) {
+        size_t capacity = project->visited_capacity ? project->visited_capacity * 2 : 64;
+        char **slots = calloc(capacity, sizeof(char *));
+        for (size_t i = 0; i < project->visited_capacity; i++) {
+            char *old = project->visited[i];
+            if (!old) continue;
+            size_t slot = hash_path(old) & (capacity - 1);
+            while (slots[slot]) slot = (slot + 1) & (capacity - 1);
+            slots[slot] = old;
+        }
+        free(project->visited);
+        project->visited = slots;
+        project->visited_capacity = capacity;
+    }
+    size_t slot = hash_path(path) & (project->visited_capacity - 1);
+    while (project->visited[slot]) {
+        if (strcmp(project->visited[slot], path) == 0) return false;
+        slot = (slot + 1) & (project->visited_capacity - 1);
+    }
+    project->visited[slot] = strdup(path);
+    project->visited_count++;
+    return true;
+}
+
+static void free_list(char **items, size_t count) {
+    for (size_t i = 0; i < count; i++) free(items[i]);
+    free(items);
+}
+
+static void free_job(ProjectJob *job) {
+    free(job->path);
+    free(job->file);
+    free(job->source_dir);
+    free_list(job->module_path, job->module_count);
+    free(job);
+}
+
+// Queues `file` to run with `source_dir` and a copy of the module path,
+// unless it was visited before. A missing file is an error unless
+// `optional`; `from` is the file that referenced it, NULL for the root.
+static void enqueue(Project *project, const char *from, const char *file, const char *source_dir,
+                    char *const *module_path, size_t module_count, bool optional) {
+    char canonical[PATH_MAX];
+    if (!realpath(file, canonical)) {
+        if (!optional) {
+            char *shown = display_path(project, file);
+            if (from) {
+                fprintf(stderr, "%s: %s: %s\n", from, shown, strerror(errno));
+            } else {
+                fprintf(stderr, "%s: %s\n", shown, strerror(errno));
+            }
+            free(shown);
+            pthread_mutex_lock(&project->lock);
+            project->ok = false;
+            pthread_mutex_unlock(&project->lock);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&project->lock);
+    if (!mark_visited(project, canonical)) {
+        pthread_mutex_unlock(&project->lock);
+        return;
+    }
+    ProjectJob *job = malloc(sizeof(ProjectJob));
+    job->path = from ? display_path(project, canonical) : strdup(file);
+    job->file = strdup(canonical);
+    job->source_dir = strdup(source_dir);
+    job->module_path = malloc((module_count + 1) * sizeof(char *));
+    for (size_t i = 0; i < module_count; i++) job->module_path[i] = strdup(module_path[i]);
+    job->module_count = module_count;
+    job->next = NULL;
+    if (project->tail) {
+        project->tail->next = job;
+    } else {
+        project->head = job;
+    }
+    project->tail = job;
+    pthread_cond_signal(&project->changed);
+    pthread_mutex_unlock(&project->lock);
+}
+
+// ---------------------------------------------------------------------------
+// The references in one file
+
+typedef struct {
+    const char *text;
+    size_t length;
+    NodeType type;
+} Argument;
+
+typedef struct {
+    const char *name;
+    const char *value;
+} DirVariable;
+
+#define MAX_ARGUMENTS 256
+
+static size_t command_arguments(const ASTNode *command, const char *source, Argument *args) {
+    size_t count = 0;
+    for (size_t i = 1; i < command->child_count && count < MAX_ARGUMENTS; i++) {
+        const ASTNode *child = command->children[i];
+        const char *text = token_text(source, child->token);
+        size_t length = child->token.length;
+        if (child->type == NODE_UNQUOTED_ARGUMENT) {
+            args[count++] = (Argument){ text, length, child->type };
+        } else if (child->type == NODE_QUOTED_ARGUMENT && length >= 2) {
+            args[count++] = (Argument){ text + 1, length - 2, child->type };
+        } else if (child->type == NODE_BRACKET_ARGUMENT) {
+            size_t open = 1; // "[", the equals signs, "["
+            while (open < length && text[open] == '=') open++;
+            open++;
+            if (length >= 2 * open) {
+                size_t skip = text[open] == '\n' ? 1 : 0; // CMake drops a newline after the opener
+                args[count++] = (Argument){ text + open + skip, length - 2 * open - skip, child->type };
+            }
+        }
+    }
+    return count;
+}
+
+static bool is_keyword(const Argument *arg, const char *keyword) {
+    return arg->type == NODE_UNQUOTED_ARGUMENT && arg->length == strlen(keyword) &&
+           memcmp(arg->text, keyword, arg->length) == 0;
+}
+
+// The argument's value with `vars` expanded, or NULL if it depends on
+// anything else (other variables, generator expressions, escapes).
+static char *literal_value(const Argument *arg, const DirVariable *vars, size_t var_count) {
+    if (arg->type == NODE_BRACKET_ARGUMENT) return copy_text(arg->text, arg->length);
+
+    size_t capacity = arg->length + 1, length = 0;
+    char *out = malloc(capacity);
+    for (size_t i = 0; i < arg->length;) {
+        const char *value = NULL;
+        size_t value_length = 1, consumed = 1;
+        if (arg->text[i] == '$' || arg->text[i] == '\\') {
+            const char *name = arg->text + i + 2;
+            const char *end = arg->text[i] == '$' && i + 1 < arg->length && arg->text[i + 1] == '{'
+                                  ? memchr(name, '}', arg->length - i - 2)
+                                  : NULL;
+            for (size_t v = 0; end && !value && v < var_count; v++) {
+                if ((size_t)(end - name) == strlen(vars[v].name) &&
+                    memcmp(name, vars[v].name, (size_t)(end - name)) == 0) {
+                    value = vars[v].value;
+                }
+            }
+            if (!value) {
+                free(out);
+                return NULL;
+            }
+            value_length = strlen(value);
+            consumed = (size_t)(end + 1 - (arg->text + i));
+        } else {
+            value = arg->text + i;
+        }
+        if (length + value_length + 1 > capacity) {
+            capacity = (length + value_length + 1) * 2;
+            out = realloc(out, capacity);
+        }
+        memcpy(out + length, value, value_length);
+        length += value_length;
+        i += consumed;
+    }
+    out[length] = '\0';
+    return out;
+}
+
+typedef struct {
+    char **items;
+    size_t count;
+} PathList;
+
+// Inserts each ;-separated element of `value` at `*at`, resolved against
+// `source_dir`, and advances `*at` past them.
+static void insert_module_dirs(PathList *list, size_t *at, const char *value, const char *source_dir) {
+    for (const char *element = value; *element;) {
+        const char *end = strchr(element, ';');
+        size_t length = end ? (size_t)(end - element) : strlen(element);
+        if (length > 0) {
+            char *name = copy_text(element, length);
+            list->items = realloc(list->items, (list->count + 1) * sizeof(char *));
+            memmove(list->items + *at + 1, list->items + *at, (list->count - *at) * sizeof(char *));
+            list->items[(*at)++] = join_path(source_dir, name);
+            list->count++;
+            free(name);
+        }
+        element += end ? length + 1 : length;
+    }
+}
+
+static char *join_list(const PathList *list) {
+    size_t length = 0;
+    for (size_t i = 0; i < list->count; i++) length += strlen(list->items[i]) + 1;
+    char *joined = malloc(length + 1);
+    joined[0] = '\0';
+    for (size_t i = 0, at = 0; i < list->count; i++) {
+        size_t n = strlen(list->items[i]);
+        if (i > 0) joined[at++] = ';';
+        memcpy(joined + at, list->items[i], n + 1);
+        at += n;
+    }
+    return joined;
+}
+
+// set(CMAKE_MODULE_PATH ...) and list(APPEND|PREPEND CMAKE_MODULE_PATH ...).
+// Values that are not literal are dropped.
+static void update_module_path(PathList *modules, const Argument *args, size_t count, bool replace,
+                               bool prepend, DirVariable *vars, size_t var_count, const char *source_dir) {
+    char *old = join_list(modules);
+    vars[var_count++] = (DirVariable){ "CMAKE_MODULE_PATH", old };
+
+    PathList updated = { NULL, 0 };
+    if (!replace) updated = *modules;
+    size_t at = prepend ? 0 : updated.count;
+    for (size_t i = 0; i < count; i++) {
+        if (replace && (is_keyword(&args[i], "PARENT_SCOPE") || is_keyword(&args[i], "CACHE"))) break;
+        char *value = literal_value(&args[i], vars, var_count);
+        if (value) insert_module_dirs(&updated, &at, value, source_dir);
+        free(value);
+    }
+    if (replace) free_list(modules->items, modules->count);
+    *modules = updated;
+    free(old);
+}
+
+static bool command_is(const ASTNode *command, const char *source, const char *name) {
+    const ASTNode *identifier = command->children[0];
+    return identifier->token.length == strlen(name) &&
+           strncasecmp(token_text(source, identifier->token), name, identifier->token.length) == 0;
+}
+
+// Queues what the file's add_subdirectory() and include() calls reach,
+// tracking CMAKE_MODULE_PATH through it as it goes.
+static void discover(Project *project, const ProjectJob *job, const ASTNode *root, const char *source) {
+    char *list_dir = dir_name(job->file);
+    DirVariable vars[5] = {
+        { "CMAKE_CURRENT_SOURCE_DIR", job->source_dir },
+        { "CMAKE_CURRENT_LIST_DIR", list_dir },
+        { "CMAKE_SOURCE_DIR", project->root_dir },
+        { "PROJECT_SOURCE_DIR", project->root_dir },
+    };
+    size_t var_count = 4;
+    PathList modules = { malloc((job->module_count + 1) * sizeof(char *)), job->module_count };
+    for (size_t i = 0; i < job->module_count; i++) modules.items[i] = strdup(job->module_path[i]);
+    Argument *args = malloc(MAX_ARGUMENTS * sizeof(Argument));
+
+    for (size_t c = 0; c < root->child_count; c++) {
+        const ASTNode *command = root->children[c];
+        if (command->type != NODE_COMMAND_INVOCATION || command->child_count == 0) continue;
+        size_t count = command_arguments(command, source, args);
+        if (count == 0) continue;
+
+        if (command_is(command, source, "add_subdirectory")) {
+            char *dir = literal_value(&args[0], vars, var_count);
+            if (!dir) continue;
+            char *source_dir = join_path(job->source_dir, dir);
+            char *file = join_path(source_dir, "CMakeLists.txt");
+            enqueue(project, job->path, file, source_dir, modules.items, modules.count, false);
+            free(file);
+            free(source_dir);
+            free(dir);
+        } else if (command_is(command, source, "include")) {
+            char *name = literal_value(&args[0], vars, var_count);
+            if (!name) continue;
+            bool optional = false;
+            for (size_t i = 1; i < count; i++) optional |= is_keyword(&args[i], "OPTIONAL");
+            size_t length = strlen(name);
+            if (strchr(name, '/') || (length > 6 && strcmp(name + length - 6, ".cmake") == 0)) {
+                char *file = join_path(job->source_dir, name);
+                enqueue(project, job->path, file, job->source_dir, modules.items, modules.count, optional);
+                free(file);
+            } else {
+                // A module: the first match on the path, else one of CMake's own.
+                char *module = malloc(length + 7);
+                memcpy(module, name, length);
+                memcpy(module + length, ".cmake", 7);
+                for (size_t m = 0; m < modules.count; m++) {
+                    char *file = join_path(modules.items[m], module);
+                    bool found = access(file, F_OK) == 0;
+                    if (found) {
+                        enqueue(project, job->path, file, job->source_dir, modules.items, modules.count, false);
+                    }
+                    free(file);
+                    if (found) break;
+                }
+                free(module);
+            }
+            free(name);
+        } else if (command_is(command, source, "set") && count >= 1 &&
+                   is_keyword(&args[0], "CMAKE_MODULE_PATH")) {
+            update_module_path(&modules, args + 1, count - 1, true, false, vars, var_count, job->source_dir);
+        } else if (command_is(command, source, "list") && count >= 2 &&
+                   (is_keyword(&args[0], "APPEND") || is_keyword(&args[0], "PREPEND")) &&
+                   is_keyword(&args[1], "CMAKE_MODULE_PATH")) {
+            update_module_path(&modules, args + 2, count - 2, false, is_keyword(&args[0], "PREPEND"), vars,
+                               var_count, job->source_dir);
+        }
+    }
+
+    free(args);
+    free_list(modules.items, modules.count);
+    free(list_dir);
+}
+
+// ---------------------------------------------------------------------------
+// Workers
+
+static bool process_file(Project *project, ProjectJob *job, BatchIo *io) {
+    // The job is freed before the trace is written, so its spans use a copy.
+    // The display path opens the same file as the canonical one.
+    const char *path = trace_path(job->path);
+    uint64_t start = trace_now();
+    BatchFile file = { path, NULL, 0, 0 };
+    batch_io_read(io, &file, 1, SOURCE_OFFSET_MAX);
+    if (!file.data) {
+        fprintf(stderr, "%s: %s\n", job->path, strerror(file.error));
+        return false;
+    }
+
+    uint64_t phase = trace_now();
+    ASTNode *ast = parse_cmake(file.data);
+    trace_span("parse", phase, path, file.length);
+
+    discover(project, job, ast, file.data);
+    bool ok = project->handler(path, file.data, file.length, ast, project->context);
+    trace_span("file", start, path, file.length); // read to the handler's write
+
+    free_ast(ast);
+    free(file.data);
+    return ok;
+}
+
+static void *project_worker(void *arg) {
+    Project *project = arg;
+    BatchIo *io = batch_io_open(false);
+
+    pthread_mutex_lock(&project->lock);
+    for (;;) {
+        while (!project->head && project->busy > 0) pthread_cond_wait(&project->changed, &project->lock);
+        ProjectJob *job = project->head;
+        if (!job) break;
+        project->head = job->next;
+        if (!project->head) project->tail = NULL;
+        project->busy++;
+        pthread_mutex_unlock(&project->lock);
+
+        bool ok = process_file(project, job, io);
+        free_job(job);
+
+        pthread_mutex_lock(&project->lock);
+        if (!ok) project->ok = false;
+        if (--project->busy == 0 && !project->head) pthread_cond_broadcast(&project->changed);
+    }
+    pthread_mutex_unlock(&project->lock);
+
+    batch_io_close(io);
+    return NULL;
+}
+
+bool project_run(const char *root_lists, int threads, ProjectFileHandler handler, void *context) {
+    Project project = {0};
+    if (!getcwd(project.cwd, sizeof(project.cwd))) {
+        perror("getcwd");
+        return false;
+    }
+    char root[PATH_MAX];
+    if (!realpath(root_lists, root)) {
+        fprintf(stderr, "%s: %s\n", root_lists, strerror(errno));
+        return false;
+    }
+    char *root_dir = dir_name(root);
+    project.root_dir = root_dir;
+    project.handler = handler;
+    project.context = context;
+    project.ok = true;
+    pthread_mutex_init(&project.lock, NULL);
+    pthread_cond_init(&project.changed, NULL);
+
+    enqueue(&project, NULL, root_lists, root_dir, NULL, 0, false);
+
+    if (threads < 1) threads = 1;
+    pthread_t *tids = malloc(sizeof(pthread_t) * (size_t)threads);
+    int started = 0;
+    for (int t = 1; t < threads; t++) {
+        if (pthread_create(&tids[started], NULL, project_worker, &project) == 0) started++;
+    }
+    project_worker(&project);
+    for (int t = 0; t < started; t++) pthread_join(tids[t], NULL);
+    free(tids);
+
+    for (size_t i = 0; i < project.visited_capacity; i++) free(project.visited[i]);
+    free(project.visited);
+    pthread_cond_destroy(&project.changed);
+    pthread_mutex_destroy(&project.lock);
+    free(root_dir);
+    return project.ok;
+}
@@ -0,0 +1,30 @@
+#ifndef PROJECT_H
+#define PROJECT_H
+
+#include "parser.h"
+#include <stdbool.h>
+
+// Called once for every file the build reaches, with its source and parse.
+// Runs on the worker threads, so several calls can be in progress at once.
+// Returns false if the file failed.
+typedef bool (*ProjectFileHandler)(const char *path, const char *source, size_t length, ASTNode *ast,
+                                   void *context);
+
+// Walks the files a CMake build reads, starting at the root CMakeLists.txt:
+// add_subdirectory() leads to <dir>/CMakeLists.txt, include() to a file or to
+// a module found on CMAKE_MODULE_PATH, as set by set() and list(APPEND|PREPEND)
+// in the including scope. Only literal arguments are followed; the directory
+// variables CMAKE_CURRENT_SOURCE_DIR, CMAKE_CURRENT_LIST_DIR, CMAKE_SOURCE_DIR
+// and PROJECT_SOURCE_DIR are expanded, anything else is skipped. Conditions
+// are not evaluated, so both branches of an if() are followed. Modules that
+// are not on the path (CMake's own) and include(... OPTIONAL) files that do
+// not exist are skipped quietly.
+//
+// `threads` workers take files off a shared queue: each one parses its file,
+// queues the files it references, then hands it to `handler`, so the rest of
+// the tree is discovered while earlier files are formatted. Every file is
+// visited once, however many times it is referenced. Returns false if a file
+// could not be read or the handler failed for one.
+bool project_run(const char *root_lists, int threads, ProjectFileHandler handler, void *context);
+
+#endif
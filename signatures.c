@@ -0,0 +1,53 @@
+#include "signatures.h"
+#include <string.h>
+#include <strings.h>
+
+typedef struct {
+    const char *text;
+    uint8_t length;
+    CommandId command;
+} SignatureSlot;
+
+#include "signatures.inc"
+
+// FNV-1a with a murmur3 finalizer. tools/gen_signatures.py has a copy that
+// must stay in sync.
+static uint32_t signature_hash(const char *text, size_t length, uint32_t seed, bool fold) {
+    uint32_t h = 2166136261u ^ seed;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (fold && c >= 'A' && c <= 'Z') c += 32;
+        h ^= c;
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static uint32_t seed_for(CommandId command, uint32_t displacement) {
+    return command * 0x9E3779B1u + displacement * 0x85EBCA77u;
+}
+
+CommandId command_lookup(const char *name, size_t length) {
+    uint32_t bucket = signature_hash(name, length, seed_for(0, 0), true) & (COMMAND_BUCKETS - 1);
+    uint32_t displacement = command_displacements[bucket] + 1u;
+    const SignatureSlot *slot =
+        &command_slots[signature_hash(name, length, seed_for(0, displacement), true) & (COMMAND_SLOTS - 1)];
+    if (slot->text && slot->length == length && strncasecmp(slot->text, name, length) == 0) {
+        return slot->command;
+    }
+    return COMMAND_UNLISTED;
+}
+
+bool command_has_keyword(CommandId command, const char *word, size_t length) {
+    uint32_t bucket = signature_hash(word, length, seed_for(command, 0), false) & (KEYWORD_BUCKETS - 1);
+    uint32_t displacement = keyword_displacements[bucket] + 1u;
+    const SignatureSlot *slot =
+        &keyword_slots[signature_hash(word, length, seed_for(command, displacement), false) & (KEYWORD_SLOTS - 1)];
+    return slot->text && slot->command == command && slot->length == length &&
+           memcmp(slot->text, word, length) == 0;
+}
@@ -0,0 +1,22 @@
+#ifndef SIGNATURES_H
+#define SIGNATURES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Built-in database of the keyword arguments each CMake command takes (see
+// tools/signatures.txt). Both lookups are a single probe into a perfect-hash
+// table generated by tools/gen_signatures.py.
+
+typedef uint16_t CommandId;
+
+// Id of every command the database does not list. Its keyword set is a list
+// of keywords common across CMake, for project functions and macros.
+#define COMMAND_UNLISTED 0
+
+// Command names are case-insensitive, as in CMake.
+CommandId command_lookup(const char *name, size_t length);
+bool command_has_keyword(CommandId command, const char *word, size_t length);
+
+#endif
@@ -0,0 +1,103 @@
+#include "sweep.h"
+#include "edits.h"
+#include "batch_io.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    size_t files;
+    size_t removed;
+    size_t added;
+} Churn;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+bool sweep_run(const char *const *config_paths, size_t config_count, const char *const *files,
+               size_t file_count, FILE *out) {
+    CMakeFormatConfig *configs = malloc(config_count * sizeof(CMakeFormatConfig));
+    for (size_t c = 0; c < config_count; c++) {
+        config_init_defaults(&configs[c]);
+        if (!config_load_from_file(&configs[c], config_paths[c])) {
+            perror(config_paths[c]);
+            free(configs);
+            return false;
+        }
+    }
+
+    Churn *churn = calloc(config_count, sizeof(Churn));
+    FormatBuffer formatted = {0};
+    EditList edits = {0};
+    double parse_ms = 0, format_ms = 0;
+    size_t total_lines = 0;
+    bool ok = true;
+
+    BatchIo *io = batch_io_open(false);
+    BatchFile reads[BATCH_IO_DEPTH];
+    for (size_t f = 0; f < file_count; f++) {
+        size_t slot = f % BATCH_IO_DEPTH;
+        double start = now_ms();
+        if (slot == 0) {
+            size_t n = file_count - f < BATCH_IO_DEPTH ? file_count - f : BATCH_IO_DEPTH;
+            for (size_t i = 0; i < n; i++) reads[i].path = files[f + i];
+            batch_io_read(io, reads, n, SOURCE_OFFSET_MAX);
+        }
+        char *source = reads[slot].data;
+        size_t length = reads[slot].length;
+        if (!source) {
+            fprintf(stderr, "%s: %s\n", files[f],
+                    reads[slot].error == EFBIG ? "file too large" : strerror(reads[slot].error));
+            ok = false;
+            continue;
+        }
+        ASTNode *ast = parse_cmake(source);
+        LineIndex lines;
+        line_index_build(&lines, source, length);
+        total_lines += lines.line_count;
+        parse_ms += now_ms() - start;
+
+        start = now_ms();
+        for (size_t c = 0; c < config_count; c++) {
+            formatted.length = 0;
+            edits.count = 0;
+            format_ast_edits(ast, source, length, &configs[c], &formatted, &edits);
+            if (edits.count > 0) {
+                size_t removed, added;
+                edit_list_count_lines(source, length, &edits, &lines, &removed, &added);
+                churn[c].files++;
+                churn[c].removed += removed;
+                churn[c].added += added;
+            }
+        }
+        format_ms += now_ms() - start;
+
+        line_index_free(&lines);
+        free_ast(ast);
+        free(source);
+    }
+    batch_io_close(io);
+
+    int width = 6;
+    for (size_t c = 0; c < config_count; c++) {
+        int n = (int)strlen(config_paths[c]);
+        if (n > width) width = n;
+    }
+    fprintf(out, "%-*s %8s %8s %8s\n", width, "config", "files", "-lines", "+lines");
+    for (size_t c = 0; c < config_count; c++) {
+        fprintf(out, "%-*s %8zu %8zu %8zu\n", width, config_paths[c], churn[c].files, churn[c].removed,
+                churn[c].added);
+    }
+    fprintf(out, "%zu files, %zu lines: read and parse %.1f ms, %zu formatter passes %.1f ms\n", file_count,
+            total_lines, parse_ms, file_count * config_count, format_ms);
+
+    edit_list_free(&edits);
+    format_buffer_free(&formatted);
+    free(churn);
+    free(configs);
+    return ok;
+}
@@ -0,0 +1,16 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// Compares candidate configs over the same files: for each config, how many
+// files formatting would change and how many lines a --diff would remove and
+// add. Every file is read and
+// parsed once; each config then costs one formatter pass over the shared AST
+// into a reused scratch buffer, and only the resulting edits are counted.
+// Writes a table to `out`; returns false if a config or file cannot be read.
+bool sweep_run(const char *const *config_paths, size_t config_count, const char *const *files,
+               size_t file_count, FILE *out);
+
+#endif
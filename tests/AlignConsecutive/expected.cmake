@@ -0,0 +1,19 @@
+set(CMAKE_CXX_STANDARD          17)
+set(CMAKE_CXX_STANDARD_REQUIRED ON)
+# Comment lines stay in the group
+set(SRC                         main.c util.c)
+set(EMPTY)
+
+set(OTHER_GROUP 1)
+set(X           2)
+find_package(Threads REQUIRED)
+find_package(ZLIB    1.2 REQUIRED)
+find_package(OpenSSL)
+
+set_property(TARGET app     PROPERTY CXX_STANDARD              17)
+set_property(TARGET library PROPERTY POSITION_INDEPENDENT_CODE ON)
+set_property(GLOBAL PROPERTY USE_FOLDERS ON)
+if(WIN32)
+  set(A      1)
+  set(LONGER 2)
+endif()
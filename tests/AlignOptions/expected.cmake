@@ -3,5 +3,5 @@ option(ENABLE_B                 "Enable B (Default)"
 option(ENABLE_AWESOME_FEATURE_C "Enables an awesome feature that should run on any host" OFF)
 
 # Different group
-option(ENABLE_UNIT_TESTS        "Enables building the unit tests"                        ON)
-option(USE_LIBRARY_X            "Enables X controllers emulation using libx"             ON)
+option(ENABLE_UNIT_TESTS "Enables building the unit tests"            ON)
+option(USE_LIBRARY_X     "Enables X controllers emulation using libx" ON)
@@ -0,0 +1,13 @@
+project(demo C)
+message(STATUS [[
+++ generated
+]])
+if(WIN32)
+set(PLATFORM_SOURCES win.c)
+endif()
+
+if(UNIX)
+set(PLATFORM_SOURCES posix.c
+  extra.c)
+endif()
+add_executable(demo main.c ${PLATFORM_SOURCES})
@@ -0,0 +1,9 @@
+project(demo C)
+if(WIN32)
+set(PLATFORM_SOURCES win.c)
+endif()
+
+if(UNIX)
+set(PLATFORM_SOURCES posix.c)
+endif()
+add_executable(demo main.c ${PLATFORM_SOURCES})
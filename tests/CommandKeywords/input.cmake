@@ -0,0 +1,6 @@
+message(STATUS "Looking for" STRING)
+install(FILES a.h b.h DESTINATION include COMPONENT dev)
+target_link_libraries(app PRIVATE core PUBLIC util)
+set(ENABLE_FOO ON CACHE BOOL "Enable foo")
+my_add_plugin(foo SOURCES a.c b.c DEPENDS bar TARGET)
+other_function(foo SOURCES a.c b.c TARGET bar)
@@ -0,0 +1,18 @@
+cmake_minimum_required(VERSION 3.10)
+project(demo C)
+
+set(SOURCES main.c util.c)
+set(HEADERS util.h)
+set(DEFINES FOO BAR)
+
+if(WIN32)
+add_definitions(-DWIN32)
+else()
+    add_definitions(-DPOSIX)
+endif()
+
+
+
+add_executable(demo ${SOURCES}
+    ${HEADERS})
+install(TARGETS demo DESTINATION bin)
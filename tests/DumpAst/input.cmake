@@ -0,0 +1,3 @@
+cmake_minimum_required(VERSION 3.10) # min
+set(NAME "héllo"
+    [[raw]])
@@ -0,0 +1,3 @@
+if(FALSE)
+message(STATUS "not part of the build")
+endif()
@@ -0,0 +1,3 @@
+function(demo_warnings target)
+  target_compile_options(${target} PRIVATE -Wall)
+endfunction()
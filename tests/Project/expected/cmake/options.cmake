@@ -0,0 +1,4 @@
+option(DEMO_TOOLS "Build the tools" ON)
+if(DEMO_TOOLS)
+  set(DEMO_TOOL_NAMES a b)
+endif()
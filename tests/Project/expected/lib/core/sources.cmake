@@ -0,0 +1,3 @@
+foreach(name IN ITEMS a b)
+  list(APPEND CORE_SOURCES ${CMAKE_CURRENT_LIST_DIR}/${name}.c)
+endforeach()
@@ -0,0 +1,6 @@
+function(add_demo name)
+  add_executable(${name} ${ARGN})
+  if(UNIX)
+    target_link_libraries(${name} PRIVATE m)
+  endif()
+endfunction()
@@ -0,0 +1,19 @@
+# A stray closer stays at the left margin
+endif()
+function(helper)
+  if(WIN32)
+    foreach(lib a b)
+      message(STATUS ${lib})
+      # else() of the foreach is indented like one of an if()
+    else()
+      set(found TRUE)
+    endwhile()
+  elseif(APPLE)
+    block(SCOPE_FOR VARIABLES)
+      set(found FALSE)
+    endblock()
+  endif()
+endfunction()
+macro(never_closed)
+  while(TRUE)
+    break()
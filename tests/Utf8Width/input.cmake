@@ -0,0 +1,11 @@
+option(ENABLE_FR "Activer la génération rapide" ON)
+option(ENABLE_JA "高速ビルドを有効にする" ON)
+option(ENABLE_ASCII "Plain description" OFF)
+
+set(NAME "Ünïcödé ñämé" )
+set(GREETING
+"こんにちは世界です")
+message(STATUS "日本語の説明文" "second")
+install(FILES "résumé.txt"
+"naïve.txt"
+DESTINATION share)
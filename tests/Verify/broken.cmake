@@ -0,0 +1 @@
+message(STATUS [==[unterminated
\ No newline at end of file
@@ -0,0 +1,4 @@
+if(A)
+  # note
+  set(X "a b" [[c]])
+endif()
@@ -0,0 +1,147 @@
+// Opens a --dump-ast=binary blob with ast_binary_open and checks it against
+// a fresh parse of the source it was made from: node count, node types,
+// parent/child links, source ranges and trivia. Also checks that damaged
+// copies of the blob are rejected.
+// Usage: ast_binary_check <blob> <source>
+#include "../parser.h"
+#include "../ast_export.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                       \
+    do {                                                       \
+        if (!(cond)) {                                         \
+            fprintf(stderr, "ast_binary_check: " __VA_ARGS__); \
+            fputc('\n', stderr);                               \
+            failures++;                                        \
+        }                                                      \
+    } while (0)
+
+// The whole file in a malloc'd (so suitably aligned) buffer.
+static char *read_all(const char *path, size_t *length) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    FormatBuffer buffer = {0};
+    char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        format_buffer_reserve(&buffer, n + 1);
+        memcpy(buffer.data + buffer.length, chunk, n);
+        buffer.length += n;
+    }
+    fclose(f);
+    format_buffer_reserve(&buffer, 1);
+    buffer.data[buffer.length] = '\0';
+    *length = buffer.length;
+    return buffer.data;
+}
+
+static size_t count_nodes(const ASTNode *node) {
+    size_t count = 1;
+    for (size_t i = 0; i < node->child_count; i++) count += count_nodes(node->children[i]);
+    return count;
+}
+
+// Walks the parse breadth-first, the order the blob stores nodes in.
+static void compare_nodes(const AstBinaryView *view, const ASTNode *root, const char *source) {
+    uint32_t count = view->header->node_count;
+    const ASTNode **order = malloc(count * sizeof(*order));
+    order[0] = root;
+    uint32_t next = 1;
+    CHECK(view->nodes[0].parent == AST_BINARY_NO_PARENT, "root has a parent");
+
+    for (uint32_t k = 0; k < count && failures == 0; k++) {
+        const ASTNode *node = order[k];
+        const AstBinaryNode *entry = &view->nodes[k];
+        CHECK(entry->node_type == node->type, "node %u: type %u, expected %u", k, entry->node_type, node->type);
+        CHECK(entry->child_count == node->child_count, "node %u: %u children, expected %zu", k,
+              entry->child_count, node->child_count);
+        CHECK(entry->first_child == next, "node %u: first child %u, expected %u", k, entry->first_child, next);
+        CHECK(entry->leading_newlines == node->leading.newlines && entry->leading_spaces == node->leading.spaces,
+              "node %u: leading trivia differs", k);
+        if (node->type != NODE_FILE && node->type != NODE_COMMAND_INVOCATION) {
+            CHECK(entry->start == node->token.offset && entry->end == node->token.offset + node->token.length,
+                  "node %u: range [%u, %u), expected [%u, %u)", k, entry->start, entry->end,
+                  (unsigned)node->token.offset, (unsigned)(node->token.offset + node->token.length));
+            CHECK(memcmp(view->source + entry->start, token_text(source, node->token), node->token.length) == 0,
+                  "node %u: text differs", k);
+        }
+        for (size_t i = 0; i < node->child_count && next < count; i++) {
+            CHECK(view->nodes[next].parent == k, "node %u: parent %u, expected %u", next, view->nodes[next].parent, k);
+            const AstBinaryNode *child = &view->nodes[next];
+            CHECK(node->type == NODE_FILE || (child->start >= entry->start && child->end <= entry->end),
+                  "node %u: range outside its parent %u", next, k);
+            order[next++] = node->children[i];
+        }
+    }
+    CHECK(next == count, "%u nodes reachable from the root, header says %u", next, count);
+    free(order);
+}
+
+static void check_rejected(const char *blob, size_t size, size_t offset, uint32_t value, const char *what) {
+    char *copy = malloc(size);
+    memcpy(copy, blob, size);
+    memcpy(copy + offset, &value, sizeof(value));
+    AstBinaryView view;
+    CHECK(!ast_binary_open(copy, size, &view), "blob with %s was accepted", what);
+    free(copy);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <blob> <source>\n", argv[0]);
+        return 2;
+    }
+    size_t blob_size, source_length;
+    char *blob = read_all(argv[1], &blob_size);
+    char *source = read_all(argv[2], &source_length);
+    if (!blob || !source) {
+        fprintf(stderr, "ast_binary_check: cannot read %s\n", !blob ? argv[1] : argv[2]);
+        return 2;
+    }
+
+    AstBinaryView view;
+    CHECK(ast_binary_open(blob, blob_size, &view), "ast_binary_open rejected the blob");
+    if (failures == 0) {
+        ASTNode *ast = parse_cmake(source);
+        CHECK(view.header->node_count == count_nodes(ast), "%u nodes, expected %zu", view.header->node_count,
+              count_nodes(ast));
+        CHECK(view.header->source_length == source_length &&
+                  memcmp(view.source, source, source_length) == 0 && view.source[source_length] == '\0',
+              "embedded source differs");
+        if (failures == 0) compare_nodes(&view, ast, source);
+        free_ast(ast);
+
+        const AstBinaryNode *last = &view.nodes[view.header->node_count - 1];
+        size_t last_offset = (size_t)((const char *)last - blob);
+        check_rejected(blob, blob_size, offsetof(AstBinaryHeader, version), AST_BINARY_VERSION + 1, "a newer version");
+        check_rejected(blob, blob_size, offsetof(AstBinaryHeader, total_size), (uint32_t)blob_size + 4,
+                       "a total size past the end");
+        check_rejected(blob, blob_size, last_offset + offsetof(AstBinaryNode, end), view.header->source_length + 1,
+                       "a range past the source");
+        check_rejected(blob, blob_size, last_offset + offsetof(AstBinaryNode, child_count), 1,
+                       "a child index past the nodes");
+        size_t root_offset = (size_t)((const char *)view.nodes - blob);
+        check_rejected(blob, blob_size, root_offset + offsetof(AstBinaryNode, first_child), 0,
+                       "a child range looping back to its node");
+        for (uint32_t i = 1; i < view.header->node_count; i++) {
+            if (view.nodes[i].parent == 0) continue;
+            check_rejected(blob, blob_size, root_offset + i * sizeof(AstBinaryNode) + offsetof(AstBinaryNode, parent),
+                           0, "a child that names another parent");
+            break;
+        }
+        if (view.header->source_length >= 3) {
+            size_t nul = (size_t)(view.source - blob) + view.header->source_length;
+            check_rejected(blob, blob_size, nul - 3, 0x41414141, "no NUL after the source");
+        }
+        CHECK(!ast_binary_open(blob, blob_size - 1, &view), "truncated blob was accepted");
+    }
+
+    free(source);
+    free(blob);
+    if (failures == 0) printf("ast_binary_check: %s ok\n", argv[1]);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,161 @@
+// Growth-rate check for inputs that have formatted in seconds rather than
+// milliseconds. Each shape is generated at doubling sizes n and parse_cmake
+// plus format_ast_to_buffer is timed. The exponent k of time ~ bytes^k is
+// fitted by least squares on the log-log points, where bytes is input plus
+// output: n-deep nesting legitimately writes O(n^2) bytes of indentation.
+// MAX_EXPONENT leaves room for the slowdown as the working set outgrows the
+// caches; an accidental quadratic loop comes out near 2.
+// Usage: complexity [shape]
+#include "../parser.h"
+#include "../config.h"
+#include "../formatter.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_EXPONENT 1.5
+#define SIZE_STEPS 5
+#define RUNS 3
+
+typedef void (*GenerateShape)(FormatBuffer *out, size_t n);
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void append(FormatBuffer *buffer, const char *text) {
+    size_t length = strlen(text);
+    format_buffer_reserve(buffer, length + 1);
+    memcpy(buffer->data + buffer->length, text, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+}
+
+static void append_repeat(FormatBuffer *buffer, const char *text, size_t n) {
+    for (size_t i = 0; i < n; i++) append(buffer, text);
+}
+
+// One command with n arguments, each on its own line.
+static void generate_long_command(FormatBuffer *out, size_t n) {
+    char line[64];
+    append(out, "add_library(target STATIC\n");
+    for (size_t i = 0; i < n; i++) {
+        snprintf(line, sizeof(line), "    src/file_%zu.c\n", i);
+        append(out, line);
+    }
+    append(out, ")\n");
+}
+
+static void generate_nested_parens(FormatBuffer *out, size_t n) {
+    append(out, "if(");
+    append_repeat(out, "(", n);
+    append(out, "x");
+    append_repeat(out, ")", n);
+    append(out, ")\nendif()\n");
+}
+
+static void generate_options(FormatBuffer *out, size_t n) {
+    char line[96];
+    for (size_t i = 0; i < n; i++) {
+        snprintf(line, sizeof(line), "option(ENABLE_FEATURE_%zu \"Enable feature %zu\" OFF)\n", i, i);
+        append(out, line);
+    }
+}
+
+// A level-2 bracket argument full of closers one '=' short.
+static void generate_bracket_near_misses(FormatBuffer *out, size_t n) {
+    append(out, "set(text [==[");
+    append_repeat(out, "]=]=", n);
+    append(out, "]==])\n");
+}
+
+static void generate_nested_blocks(FormatBuffer *out, size_t n) {
+    append_repeat(out, "if(A)\n", n);
+    append(out, "message(x)\n");
+    append_repeat(out, "endif()\n", n);
+}
+
+typedef struct {
+    const char *name;
+    GenerateShape generate;
+    size_t first_size;
+} Shape;
+
+static const Shape shapes[] = {
+    { "long_command", generate_long_command, 4000 },
+    { "nested_parens", generate_nested_parens, 65536 },
+    { "options", generate_options, 2000 },
+    { "bracket_near_misses", generate_bracket_near_misses, 16000 },
+    { "nested_blocks", generate_nested_blocks, 250 },
+};
+
+// Best of RUNS, in seconds.
+static double time_format(const FormatBuffer *source, const CMakeFormatConfig *config, size_t *output_length) {
+    double best = 1e30;
+    for (int run = 0; run < RUNS; run++) {
+        FormatBuffer out = {0};
+        double t0 = now_seconds();
+        ASTNode *ast = parse_cmake(source->data);
+        format_ast_to_buffer(ast, source->data, config, &out);
+        double elapsed = now_seconds() - t0;
+        if (elapsed < best) best = elapsed;
+        *output_length = out.length;
+        free_ast(ast);
+        format_buffer_free(&out);
+    }
+    return best;
+}
+
+static bool check_shape(const Shape *shape, const CMakeFormatConfig *config) {
+    double xs[SIZE_STEPS], ys[SIZE_STEPS];
+    size_t n = shape->first_size;
+    printf("%s\n", shape->name);
+    for (int step = 0; step < SIZE_STEPS; step++, n *= 2) {
+        FormatBuffer source = {0};
+        shape->generate(&source, n);
+        size_t output_length;
+        double seconds = time_format(&source, config, &output_length);
+        size_t bytes = source.length + output_length;
+        printf("  n=%-8zu %10zu bytes %10.3f ms\n", n, bytes, seconds * 1000);
+        xs[step] = log((double)bytes);
+        ys[step] = log(seconds > 1e-7 ? seconds : 1e-7);
+        format_buffer_free(&source);
+    }
+
+    double mean_x = 0, mean_y = 0;
+    for (int i = 0; i < SIZE_STEPS; i++) {
+        mean_x += xs[i] / SIZE_STEPS;
+        mean_y += ys[i] / SIZE_STEPS;
+    }
+    double covariance = 0, variance = 0;
+    for (int i = 0; i < SIZE_STEPS; i++) {
+        covariance += (xs[i] - mean_x) * (ys[i] - mean_y);
+        variance += (xs[i] - mean_x) * (xs[i] - mean_x);
+    }
+    double exponent = covariance / variance;
+    bool ok = exponent <= MAX_EXPONENT;
+    printf("  exponent %.2f%s\n", exponent, ok ? "" : " (FAIL: grows faster than linear)");
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    CMakeFormatConfig config;
+    config_init_defaults(&config);
+    config.AlignOptions = true;
+
+    int failures = 0, checked = 0;
+    for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); i++) {
+        if (argc > 1 && strcmp(argv[1], shapes[i].name) != 0) continue;
+        checked++;
+        if (!check_shape(&shapes[i], &config)) failures++;
+    }
+    if (checked == 0) {
+        fprintf(stderr, "unknown shape: %s\n", argv[1]);
+        return 2;
+    }
+    return failures ? 1 : 0;
+}
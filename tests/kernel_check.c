@@ -0,0 +1,92 @@
+// Formats golden inputs with the config-specialized kernel and with the
+// generic one and checks the outputs are identical. Each input is formatted
+// with the default config and, when its own .cmake_format also selects a
+// specialized kernel, with that too.
+// Usage: kernel_check <test dir> ...
+#include "../parser.h"
+#include "../config.h"
+#include "../formatter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char *read_all(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    FormatBuffer buffer = {0};
+    char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        format_buffer_reserve(&buffer, n + 1);
+        memcpy(buffer.data + buffer.length, chunk, n);
+        buffer.length += n;
+    }
+    fclose(f);
+    format_buffer_reserve(&buffer, 1);
+    buffer.data[buffer.length] = '\0';
+    return buffer.data;
+}
+
+// Returns false if the two kernels disagree on `source` under `config`.
+static bool compare_kernels(const char *label, const char *source, const CMakeFormatConfig *config) {
+    ASTNode *ast = parse_cmake(source);
+    FormatBuffer generic = {0}, specialized = {0};
+    formatter_force_generic = true;
+    format_ast_to_buffer(ast, source, config, &generic);
+    formatter_force_generic = false;
+    format_ast_to_buffer(ast, source, config, &specialized);
+
+    bool same = generic.length == specialized.length && memcmp(generic.data, specialized.data, generic.length) == 0;
+    if (!same) {
+        size_t at = 0;
+        while (at < generic.length && at < specialized.length && generic.data[at] == specialized.data[at]) at++;
+        fprintf(stderr, "kernel_check: %s: %s kernel differs from generic at byte %zu\n", label,
+                formatter_kernel_name(config), at);
+    }
+    format_buffer_free(&generic);
+    format_buffer_free(&specialized);
+    free_ast(ast);
+    return same;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <test dir> ...\n", argv[0]);
+        return 2;
+    }
+
+    CMakeFormatConfig defaults;
+    config_init_defaults(&defaults);
+    if (strcmp(formatter_kernel_name(&defaults), "generic") == 0) {
+        fprintf(stderr, "kernel_check: the default config does not select a specialized kernel\n");
+        return 1;
+    }
+
+    bool ok = true;
+    size_t compared = 0;
+    char path[4096];
+    for (int i = 1; i < argc; i++) {
+        snprintf(path, sizeof(path), "%s/input.cmake", argv[i]);
+        char *source = read_all(path);
+        if (!source) {
+            perror(path);
+            ok = false;
+            continue;
+        }
+        ok &= compare_kernels(path, source, &defaults);
+        compared++;
+
+        CMakeFormatConfig config;
+        config_init_defaults(&config);
+        snprintf(path, sizeof(path), "%s/.cmake_format", argv[i]);
+        if (config_load_from_file(&config, path) && strcmp(formatter_kernel_name(&config), "generic") != 0) {
+            snprintf(path, sizeof(path), "%s/input.cmake with its .cmake_format", argv[i]);
+            ok &= compare_kernels(path, source, &config);
+            compared++;
+        }
+        free(source);
+    }
+
+    printf("kernel_check: %zu comparisons, %s\n", compared, ok ? "all identical" : "MISMATCH");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,41 @@
+# Formats more files than fit in one batch, some already formatted and one
+# missing, and checks each one came out right; once through the blocking path
+# and once with --io-uring
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy "${TEST_DIR}/.cmake_format" ".cmake_format" RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "copy .cmake_format failed")
+endif()
+
+file(READ "${TEST_DIR}/input.cmake" input)
+file(READ "${TEST_DIR}/expected.cmake" expected)
+foreach(mode "" "--io-uring")
+    file(REMOVE_RECURSE "temp_batch_io")
+    set(files "")
+    foreach(i RANGE 299)
+        if(i EQUAL 150)
+            list(APPEND files "temp_batch_io/missing.cmake")
+        endif()
+        math(EXPR formatted "${i} % 3")
+        if(formatted EQUAL 0)
+            file(WRITE "temp_batch_io/f${i}.cmake" "${expected}")
+        else()
+            file(WRITE "temp_batch_io/f${i}.cmake" "${input}")
+        endif()
+        list(APPEND files "temp_batch_io/f${i}.cmake")
+    endforeach()
+
+    execute_process(COMMAND "${CMAKEF_EXE}" ${mode} ${files} RESULT_VARIABLE res ERROR_VARIABLE err)
+    if(NOT res)
+        message(FATAL_ERROR "${mode}: cmakefmt succeeded although a file is missing")
+    endif()
+    if(NOT err MATCHES "temp_batch_io/missing.cmake: ")
+        message(FATAL_ERROR "${mode}: missing file not reported: ${err}")
+    endif()
+
+    foreach(i RANGE 299)
+        file(READ "temp_batch_io/f${i}.cmake" output)
+        if(NOT output STREQUAL expected)
+            message(FATAL_ERROR "${mode}: temp_batch_io/f${i}.cmake was not formatted:\n${output}")
+        endif()
+    endforeach()
+endforeach()
@@ -0,0 +1,41 @@
+# Commit before.cmake to a scratch repository, change it to after.cmake and
+# check that only the changed lines get formatted.
+set(repo "${CMAKE_CURRENT_BINARY_DIR}/temp_changed_since")
+file(REMOVE_RECURSE "${repo}")
+file(MAKE_DIRECTORY "${repo}")
+file(COPY "${TEST_DIR}/.cmake_format" DESTINATION "${repo}")
+configure_file("${TEST_DIR}/before.cmake" "${repo}/CMakeLists.txt" COPYONLY)
+
+execute_process(COMMAND "${GIT_EXE}" init -q WORKING_DIRECTORY "${repo}" RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "git init failed")
+endif()
+execute_process(COMMAND "${GIT_EXE}" add CMakeLists.txt WORKING_DIRECTORY "${repo}" RESULT_VARIABLE res)
+execute_process(COMMAND "${GIT_EXE}" -c user.name=test -c user.email=test@example.com commit -q -m before
+                WORKING_DIRECTORY "${repo}" RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "git commit failed")
+endif()
+
+# diff.noprefix and diff.mnemonicPrefix change the "b/" prefix git prints.
+foreach(prefix_config "" diff.noprefix diff.mnemonicPrefix)
+    if(prefix_config)
+        execute_process(COMMAND "${GIT_EXE}" config ${prefix_config} true WORKING_DIRECTORY "${repo}")
+    endif()
+    configure_file("${TEST_DIR}/after.cmake" "${repo}/CMakeLists.txt" COPYONLY)
+
+    execute_process(COMMAND "${CMAKEF_EXE}" "--changed-since=HEAD" WORKING_DIRECTORY "${repo}" RESULT_VARIABLE res)
+    if(res)
+        message(FATAL_ERROR "cmakefmt failed with ${prefix_config}")
+    endif()
+
+    execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files "${TEST_DIR}/expected.cmake" "${repo}/CMakeLists.txt"
+                    RESULT_VARIABLE res)
+    if(res)
+        message(FATAL_ERROR "compare failed with ${prefix_config}")
+    endif()
+
+    if(prefix_config)
+        execute_process(COMMAND "${GIT_EXE}" config --unset ${prefix_config} WORKING_DIRECTORY "${repo}")
+    endif()
+endforeach()
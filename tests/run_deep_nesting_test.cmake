@@ -0,0 +1,16 @@
+# A condition nested a million parens deep must parse without recursion
+# and come out unchanged
+string(REPEAT "(" 1000000 open)
+string(REPEAT ")" 1000000 close)
+file(WRITE "temp_deep_nesting.cmake" "if${open}x${close}\nendif()\n")
+file(WRITE ".cmake_format" "")
+
+execute_process(COMMAND "${CMAKEF_EXE}" "--verify" "temp_deep_nesting.cmake" RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "cmakefmt failed on deeply nested parens")
+endif()
+
+file(READ "temp_deep_nesting.cmake" output)
+if(NOT output STREQUAL "if${open}x${close}\nendif()\n")
+    message(FATAL_ERROR "deeply nested input was changed")
+endif()
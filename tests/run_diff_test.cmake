@@ -0,0 +1,25 @@
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy "${TEST_DIR}/input.cmake" "${TARGET_FILE}" RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "copy input.cmake failed")
+endif()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy "${TEST_DIR}/.cmake_format" ".cmake_format" RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "copy .cmake_format failed")
+endif()
+
+execute_process(COMMAND "${CMAKEF_EXE}" "--diff" "${TARGET_FILE}" OUTPUT_FILE "temp_diff.patch" RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "cmakefmt --diff failed")
+endif()
+
+# --diff must leave the file alone
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files "${TEST_DIR}/input.cmake" "${TARGET_FILE}" RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "--diff modified the input file")
+endif()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files "${TEST_DIR}/expected.diff" "temp_diff.patch" RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "compare failed")
+endif()
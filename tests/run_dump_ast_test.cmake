@@ -0,0 +1,41 @@
+# Dumps are written for the path as given, so run next to the input
+execute_process(COMMAND "${CMAKEF_EXE}" "--dump-ast=json" "input.cmake"
+                WORKING_DIRECTORY "${TEST_DIR}"
+                OUTPUT_FILE "${CMAKE_CURRENT_BINARY_DIR}/temp_dump_ast.json"
+                RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "cmakefmt --dump-ast=json failed")
+endif()
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files "${TEST_DIR}/expected.json" "temp_dump_ast.json" RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "JSON dump differs from expected.json")
+endif()
+
+execute_process(COMMAND "${CMAKEF_EXE}" "--dump-ast=binary" "input.cmake"
+                WORKING_DIRECTORY "${TEST_DIR}"
+                OUTPUT_FILE "${CMAKE_CURRENT_BINARY_DIR}/temp_dump_ast.bin"
+                RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "cmakefmt --dump-ast=binary failed")
+endif()
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files "${TEST_DIR}/expected.bin" "temp_dump_ast.bin" RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "binary dump differs from expected.bin")
+endif()
+
+# The zero-copy loader, on this blob and on a larger one
+execute_process(COMMAND "${AST_BINARY_CHECK}" "temp_dump_ast.bin" "${TEST_DIR}/input.cmake" RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "ast_binary_open check failed")
+endif()
+execute_process(COMMAND "${CMAKEF_EXE}" "--dump-ast=binary" "${TEST_DIR}/../StressTestDocs/input.cmake"
+                OUTPUT_FILE "${CMAKE_CURRENT_BINARY_DIR}/temp_dump_ast_stress.bin"
+                RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "cmakefmt --dump-ast=binary failed on StressTestDocs")
+endif()
+execute_process(COMMAND "${AST_BINARY_CHECK}" "temp_dump_ast_stress.bin" "${TEST_DIR}/../StressTestDocs/input.cmake"
+                RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "ast_binary_open check failed on StressTestDocs")
+endif()
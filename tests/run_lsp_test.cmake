@@ -0,0 +1,35 @@
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy "${TEST_DIR}/.cmake_format" ".cmake_format" RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "copy .cmake_format failed")
+endif()
+
+# Frame each line of the scripted session as a JSON-RPC message
+file(STRINGS "${TEST_DIR}/session.jsonl" messages ENCODING UTF-8)
+set(framed "")
+foreach(message IN LISTS messages)
+    string(REPLACE "__TEST_DIR__" "${TEST_DIR}" message "${message}")
+    string(LENGTH "${message}" length)
+    string(APPEND framed "Content-Length: ${length}\r\n\r\n${message}")
+endforeach()
+file(WRITE "temp_lsp_input.txt" "${framed}")
+
+execute_process(COMMAND "${CMAKEF_EXE}" "--lsp"
+                INPUT_FILE "temp_lsp_input.txt"
+                OUTPUT_VARIABLE output
+                RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "cmakefmt --lsp exited with ${res}")
+endif()
+
+string(REPLACE "${TEST_DIR}" "__TEST_DIR__" output "${output}")
+# One header line and one body line per message
+string(REPLACE "\r\n" "\n" output "${output}")
+string(REPLACE "\n\n" "\n" output "${output}")
+string(REPLACE "}Content-Length:" "}\nContent-Length:" output "${output}")
+string(APPEND output "\n")
+file(WRITE "temp_lsp_output.txt" "${output}")
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files "${TEST_DIR}/expected.txt" "temp_lsp_output.txt" RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "compare failed")
+endif()
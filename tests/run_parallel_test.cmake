@@ -0,0 +1,58 @@
+# Formats `content` sequentially and with -j 8 under the config in
+# `config_text`, and checks both give the same output
+function(check_parallel name config_text content)
+    file(WRITE ".cmake_format" "${config_text}")
+    file(WRITE "temp_parallel_${name}_seq.cmake" "${content}")
+    file(WRITE "temp_parallel_${name}_par.cmake" "${content}")
+
+    execute_process(COMMAND "${CMAKEF_EXE}" "temp_parallel_${name}_seq.cmake" RESULT_VARIABLE res)
+    if(res)
+        message(FATAL_ERROR "${name}: cmakefmt failed")
+    endif()
+
+    execute_process(COMMAND "${CMAKEF_EXE}" "-j" "8" "temp_parallel_${name}_par.cmake" RESULT_VARIABLE res)
+    if(res)
+        message(FATAL_ERROR "${name}: cmakefmt -j 8 failed")
+    endif()
+
+    execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files "temp_parallel_${name}_seq.cmake"
+                    "temp_parallel_${name}_par.cmake" RESULT_VARIABLE res)
+    if(res)
+        message(FATAL_ERROR "${name}: -j 8 output differs from the sequential output")
+    endif()
+endfunction()
+
+file(READ "${TEST_DIR}/.cmake_format" config)
+
+# An input large enough to be split into many chunks
+file(READ "${TEST_DIR}/../StressTestDocs/input.cmake" stress)
+file(READ "${TEST_DIR}/../AlignOptions/input.cmake" options)
+file(READ "${TEST_DIR}/../IndentWidth/input.cmake" blocks)
+set(content "")
+foreach(i RANGE 60)
+    string(APPEND content "${stress}\n${options}\n${blocks}\n")
+endforeach()
+check_parallel(mixed "${config}" "${content}")
+
+# Commands separated by single newlines, so chunks start right after the
+# previous command, inside blocks that cross the chunk boundaries
+string(REPEAT "if(A)\nset(X 1)\nendif()\n" 400 content)
+check_parallel(blocks "${config}" "${content}")
+string(REPEAT "if(A)\nforeach(x IN ITEMS a b)\nset(X 1)\nendforeach()\n" 300 content)
+check_parallel(open_blocks "${config}" "${content}")
+
+# Aligned runs of commands that span chunk boundaries
+file(READ "${TEST_DIR}/../AlignConsecutive/.cmake_format" align_config)
+string(REPLACE "..." "AlignOptions: true\n..." align_config "${align_config}")
+file(READ "${TEST_DIR}/../AlignConsecutive/input.cmake" align)
+set(content "")
+foreach(i RANGE 600)
+    string(REPEAT "x" ${i} name)
+    math(EXPR width "${i} % 37")
+    string(SUBSTRING "${name}" 0 ${width} name)
+    string(APPEND content "set(V${name} ${i})\n")
+endforeach()
+foreach(i RANGE 40)
+    string(APPEND content "${align}\nif(A)\noption(USE_${i} \"Use ${i}\" ON)\nendif()\n")
+endforeach()
+check_parallel(align "${align_config}" "${content}")
@@ -0,0 +1,59 @@
+# Formats a project from its root CMakeLists.txt and checks that exactly the
+# files the build reads were formatted: the unused module and the directory
+# only named through a variable stay as they were
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy "${TEST_DIR}/.cmake_format" ".cmake_format" RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "copy .cmake_format failed")
+endif()
+
+file(REMOVE_RECURSE "temp_project")
+file(COPY "${TEST_DIR}/input/" DESTINATION "temp_project")
+
+# Each file the build reads is visited once: on the unformatted tree, a diff
+# has exactly one header per reachable file, although lib/CMakeLists.txt
+# includes Warnings.cmake again
+execute_process(COMMAND "${CMAKEF_EXE}" -j 4 --diff --project temp_project/CMakeLists.txt
+                RESULT_VARIABLE res OUTPUT_VARIABLE diff ERROR_VARIABLE err)
+if(res)
+    message(FATAL_ERROR "cmakefmt --diff --project failed: ${err}")
+endif()
+string(REGEX MATCHALL "\n\\+\\+\\+ b/[^\n]*" headers "\n${diff}")
+list(LENGTH headers header_count)
+set(reachable CMakeLists.txt cmake/Warnings.cmake cmake/options.cmake lib/CMakeLists.txt
+    lib/core/CMakeLists.txt lib/core/sources.cmake tools/CMakeLists.txt)
+list(LENGTH reachable reachable_count)
+if(NOT header_count EQUAL reachable_count)
+    message(FATAL_ERROR "expected ${reachable_count} files in the diff, got ${header_count}:\n${diff}")
+endif()
+foreach(name ${reachable})
+    list(FIND headers "\n+++ b/temp_project/${name}" index)
+    if(index EQUAL -1)
+        message(FATAL_ERROR "temp_project/${name} missing from the diff:\n${diff}")
+    endif()
+endforeach()
+
+execute_process(COMMAND "${CMAKEF_EXE}" -j 4 --project temp_project/CMakeLists.txt
+                RESULT_VARIABLE res ERROR_VARIABLE err)
+if(res)
+    message(FATAL_ERROR "cmakefmt --project failed: ${err}")
+endif()
+
+file(GLOB_RECURSE expected_files RELATIVE "${TEST_DIR}/expected" "${TEST_DIR}/expected/*")
+foreach(name ${expected_files})
+    file(READ "${TEST_DIR}/expected/${name}" expected)
+    file(READ "temp_project/${name}" output)
+    if(NOT output STREQUAL expected)
+        message(FATAL_ERROR "temp_project/${name} differs from expected:\n${output}")
+    endif()
+endforeach()
+
+# A subdirectory that does not exist fails the run
+file(APPEND "temp_project/lib/CMakeLists.txt" "add_subdirectory(missing)\n")
+execute_process(COMMAND "${CMAKEF_EXE}" --project temp_project/CMakeLists.txt
+                RESULT_VARIABLE res ERROR_VARIABLE err)
+if(NOT res)
+    message(FATAL_ERROR "cmakefmt --project succeeded although a subdirectory is missing")
+endif()
+if(NOT err MATCHES "temp_project/lib/CMakeLists.txt: .*missing/CMakeLists.txt: ")
+    message(FATAL_ERROR "missing subdirectory not reported: ${err}")
+endif()
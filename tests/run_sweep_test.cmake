@@ -0,0 +1,23 @@
+file(SHA256 "${TEST_DIR}/helpers.cmake" before)
+
+execute_process(COMMAND "${CMAKEF_EXE}" --sweep
+                        indent2.cmake_format indent4.cmake_format space_before_parens.cmake_format
+                        -- CMakeLists.txt helpers.cmake
+                WORKING_DIRECTORY "${TEST_DIR}"
+                OUTPUT_VARIABLE report
+                RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "cmakefmt --sweep failed:\n${report}")
+endif()
+
+# The last line holds timings.
+string(REGEX REPLACE "[^\n]*\n$" "" table "${report}")
+file(READ "${TEST_DIR}/expected.txt" expected)
+if(NOT table STREQUAL expected)
+    message(FATAL_ERROR "sweep report differs from expected.txt:\n${report}")
+endif()
+
+file(SHA256 "${TEST_DIR}/helpers.cmake" after)
+if(NOT before STREQUAL after)
+    message(FATAL_ERROR "--sweep rewrote a file")
+endif()
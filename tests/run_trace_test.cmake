@@ -0,0 +1,49 @@
+# string(JSON) needs 3.19
+cmake_minimum_required(VERSION 3.19)
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy "${TEST_DIR}/input.cmake" "temp_trace.cmake")
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy "${TEST_DIR}/.cmake_format" ".cmake_format")
+file(REMOVE "temp_trace.json")
+
+execute_process(COMMAND "${CMAKEF_EXE}" "--trace-out=temp_trace.json" "temp_trace.cmake" RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "cmakefmt --trace-out failed")
+endif()
+
+file(READ "temp_trace.json" trace)
+file(SIZE "${TEST_DIR}/input.cmake" input_size)
+
+# Every phase of the file must appear as a complete span tagged with the file
+string(JSON count LENGTH "${trace}" traceEvents)
+set(seen "")
+math(EXPR last "${count} - 1")
+foreach(i RANGE ${last})
+    string(JSON name GET "${trace}" traceEvents ${i} name)
+    string(JSON ph GET "${trace}" traceEvents ${i} ph)
+    string(JSON tid GET "${trace}" traceEvents ${i} tid)
+    string(JSON path GET "${trace}" traceEvents ${i} args path)
+    string(JSON bytes GET "${trace}" traceEvents ${i} args bytes)
+    string(JSON ts GET "${trace}" traceEvents ${i} ts)
+    string(JSON dur GET "${trace}" traceEvents ${i} dur)
+    math(EXPR ${name}_start "${ts}")
+    math(EXPR ${name}_end "${ts} + ${dur}")
+    if(NOT ph STREQUAL "X" OR NOT path STREQUAL "temp_trace.cmake" OR NOT tid GREATER 0)
+        message(FATAL_ERROR "malformed span ${i}: ${trace}")
+    endif()
+    if(name STREQUAL "read" AND NOT bytes EQUAL input_size)
+        message(FATAL_ERROR "read span has ${bytes} bytes, expected ${input_size}")
+    endif()
+    list(APPEND seen ${name})
+endforeach()
+
+foreach(phase read parse format write file)
+    if(NOT phase IN_LIST seen)
+        message(FATAL_ERROR "no '${phase}' span in trace: ${seen}")
+    endif()
+endforeach()
+
+# The file span covers the whole file, from its read to its write
+if(read_start LESS file_start OR write_end GREATER file_end)
+    message(FATAL_ERROR "file span [${file_start}, ${file_end}) does not cover the read at ${read_start} "
+                        "and the write ending at ${write_end}")
+endif()
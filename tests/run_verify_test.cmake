@@ -0,0 +1,30 @@
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy "${TEST_DIR}/.cmake_format" ".cmake_format" RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "copy .cmake_format failed")
+endif()
+
+# A well-formed file formats normally
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy "${TEST_DIR}/input.cmake" "temp_verify_ok.cmake")
+execute_process(COMMAND "${CMAKEF_EXE}" "--verify" "temp_verify_ok.cmake" RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "cmakefmt --verify rejected a valid file")
+endif()
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files "${TEST_DIR}/expected.cmake" "temp_verify_ok.cmake" RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "compare failed")
+endif()
+
+# The trailing newline would end up inside the unterminated bracket argument,
+# so the output must be refused and the file left alone
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy "${TEST_DIR}/broken.cmake" "temp_verify_broken.cmake")
+execute_process(COMMAND "${CMAKEF_EXE}" "--verify" "temp_verify_broken.cmake" RESULT_VARIABLE res ERROR_VARIABLE err)
+if(NOT res)
+    message(FATAL_ERROR "cmakefmt --verify accepted a changed token stream")
+endif()
+if(NOT err MATCHES "temp_verify_broken.cmake:1:16: error")
+    message(FATAL_ERROR "unexpected diagnostic: ${err}")
+endif()
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files "${TEST_DIR}/broken.cmake" "temp_verify_broken.cmake" RESULT_VARIABLE res)
+if(res)
+    message(FATAL_ERROR "--verify wrote a rejected file")
+endif()
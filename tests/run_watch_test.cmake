@@ -0,0 +1,60 @@
+# Runs cmakefmt --watch alongside a scripted editor (this script again, with
+# EDITOR set), stops both after a timeout and checks what got formatted.
+if(EDITOR)
+    execute_process(COMMAND ${CMAKE_COMMAND} -E sleep 0.5)
+    # Saved in place
+    file(WRITE "${WATCH_DIR}/CMakeLists.txt" "set(A   b)\n")
+    # Saved through a temporary file in a directory created after startup
+    file(MAKE_DIRECTORY "${WATCH_DIR}/sub")
+    file(WRITE "${WATCH_DIR}/sub/.x.cmake.swp" "if(X)\nmessage(hi)\nendif()\n")
+    file(RENAME "${WATCH_DIR}/sub/.x.cmake.swp" "${WATCH_DIR}/sub/x.cmake")
+    # Inside a build tree
+    file(WRITE "${WATCH_DIR}/build/generated.cmake" "set(C   d)\n")
+    # Outside the root, reachable only through a symlink
+    file(WRITE "${WATCH_DIR}_outside/other.cmake" "set(E   f)\n")
+    return()
+endif()
+
+set(dir "${CMAKE_CURRENT_BINARY_DIR}/temp_watch")
+file(REMOVE_RECURSE "${dir}")
+file(MAKE_DIRECTORY "${dir}/build")
+file(WRITE "${dir}/build/CMakeCache.txt" "")
+file(WRITE "${dir}/.cmake_format" "IndentWidth: 2\n")
+# Symlinked directories are not followed: two links to the parent would make
+# the walk grow without end, and a link out of the root would watch a tree
+# that is not ours.
+file(REMOVE_RECURSE "${dir}_outside")
+file(MAKE_DIRECTORY "${dir}_outside")
+file(CREATE_LINK ".." "${dir}/up1" SYMBOLIC)
+file(CREATE_LINK ".." "${dir}/up2" SYMBOLIC)
+file(CREATE_LINK "${dir}_outside" "${dir}/outside" SYMBOLIC)
+
+execute_process(COMMAND "${CMAKEF_EXE}" --watch "${dir}"
+                COMMAND ${CMAKE_COMMAND} -DEDITOR=ON -DWATCH_DIR=${dir} -P ${CMAKE_CURRENT_LIST_FILE}
+                WORKING_DIRECTORY "${dir}"
+                TIMEOUT 3
+                ERROR_VARIABLE log)
+
+file(READ "${dir}/CMakeLists.txt" top)
+file(READ "${dir}/sub/x.cmake" sub)
+file(READ "${dir}/build/generated.cmake" generated)
+file(READ "${dir}_outside/other.cmake" outside)
+if(NOT top STREQUAL "set(A b)\n")
+    message(FATAL_ERROR "CMakeLists.txt not formatted:\n${top}\n${log}")
+endif()
+if(NOT sub STREQUAL "if(X)\n  message(hi)\nendif()\n")
+    message(FATAL_ERROR "renamed file not formatted:\n${sub}\n${log}")
+endif()
+if(NOT generated STREQUAL "set(C   d)\n")
+    message(FATAL_ERROR "file in a build tree was formatted:\n${log}")
+endif()
+if(NOT outside STREQUAL "set(E   f)\n")
+    message(FATAL_ERROR "file behind a symlink out of the root was formatted:\n${log}")
+endif()
+
+# The watcher's own writes must not be picked up as new saves.
+string(REGEX MATCHALL "formatted in" runs "${log}")
+list(LENGTH runs count)
+if(NOT count EQUAL 2)
+    message(FATAL_ERROR "expected 2 reformats, got ${count}:\n${log}")
+endif()
@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+"""Generates signatures.inc, the perfect-hash tables behind signatures.c.
+
+Reads tools/signatures.txt and lays out two tables with hash-and-displace:
+one from command names to command ids and one keyed on (command id,
+keyword). A lookup hashes its key once to pick a bucket, once more with the
+bucket's displacement to pick a slot, and compares that single slot.
+
+    python3 tools/gen_signatures.py           rewrite signatures.inc
+    python3 tools/gen_signatures.py --check   fail if it is out of date
+"""
+
+import os
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SOURCE = os.path.join(ROOT, "tools", "signatures.txt")
+OUTPUT = os.path.join(ROOT, "signatures.inc")
+
+MASK = 0xFFFFFFFF
+COMMAND_MIX = 0x9E3779B1
+DISPLACEMENT_MIX = 0x85EBCA77
+
+
+# Must match signature_hash() in signatures.c.
+def signature_hash(text, seed, fold):
+    h = (2166136261 ^ seed) & MASK
+    for c in text.encode():
+        if fold and ord("A") <= c <= ord("Z"):
+            c += 32
+        h ^= c
+        h = (h * 16777619) & MASK
+    h ^= h >> 16
+    h = (h * 0x85EBCA6B) & MASK
+    h ^= h >> 13
+    h = (h * 0xC2B2AE35) & MASK
+    h ^= h >> 16
+    return h
+
+
+def seed_for(command, displacement):
+    return (command * COMMAND_MIX + displacement * DISPLACEMENT_MIX) & MASK
+
+
+def next_power_of_two(n):
+    p = 1
+    while p < n:
+        p *= 2
+    return p
+
+
+def read_signatures():
+    entries = []
+    with open(SOURCE) as f:
+        for raw in f:
+            line = raw.split("#", 1)[0].rstrip()
+            if not line:
+                continue
+            words = line.split()
+            if raw[0].isspace():
+                entries[-1][1].extend(words)
+            else:
+                entries.append((words[0], words[1:]))
+    fallback = [e for e in entries if e[0] == "*"]
+    commands = [e for e in entries if e[0] != "*"]
+    if len(fallback) != 1:
+        sys.exit("signatures.txt needs exactly one '*' entry")
+    names = [name.lower() for name, _ in commands]
+    if len(set(names)) != len(names):
+        sys.exit("signatures.txt lists a command twice")
+    # Command 0 is the fallback for commands not in the table.
+    return [("*", sorted(set(fallback[0][1])))] + [(n.lower(), sorted(set(k))) for n, k in commands]
+
+
+def build(keys, hash_key):
+    """keys: list of (key, payload). Returns (displacements, slots)."""
+    slot_count = next_power_of_two(len(keys))
+    bucket_count = next_power_of_two(max(1, len(keys) // 3))
+    buckets = [[] for _ in range(bucket_count)]
+    for key in keys:
+        buckets[hash_key(key, 0) & (bucket_count - 1)].append(key)
+
+    displacements = [0] * bucket_count
+    slots = [None] * slot_count
+    for index in sorted(range(bucket_count), key=lambda b: -len(buckets[b])):
+        bucket = buckets[index]
+        if not bucket:
+            continue
+        for d in range(1 << 16):
+            chosen = [hash_key(key, d + 1) & (slot_count - 1) for key in bucket]
+            if len(set(chosen)) == len(chosen) and all(slots[s] is None for s in chosen):
+                break
+        else:
+            sys.exit("no displacement found; enlarge the tables")
+        displacements[index] = d
+        for key, s in zip(bucket, chosen):
+            slots[s] = key
+    return displacements, slots
+
+
+def c_string(text):
+    return '"' + text.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def emit_array(lines, decl, items, per_line):
+    lines.append(decl + " = {")
+    for i in range(0, len(items), per_line):
+        lines.append("    " + " ".join(items[i:i + per_line]))
+    lines.append("};")
+
+
+def generate():
+    signatures = read_signatures()
+
+    command_keys = [(name, i) for i, (name, _) in enumerate(signatures) if i > 0]
+    command_displacements, command_slots = build(
+        command_keys, lambda key, d: signature_hash(key[0], seed_for(0, d), True))
+
+    keyword_keys = [(word, i) for i, (_, words) in enumerate(signatures) for word in words]
+    keyword_displacements, keyword_slots = build(
+        keyword_keys, lambda key, d: signature_hash(key[0], seed_for(key[1], d), False))
+
+    lines = [
+        "// Generated by tools/gen_signatures.py from tools/signatures.txt. Do not edit.",
+        "",
+        "#define SIGNATURE_COMMANDS %d" % len(signatures),
+        "#define SIGNATURE_KEYWORDS %d" % len(keyword_keys),
+        "#define COMMAND_BUCKETS %d" % len(command_displacements),
+        "#define COMMAND_SLOTS %d" % len(command_slots),
+        "#define KEYWORD_BUCKETS %d" % len(keyword_displacements),
+        "#define KEYWORD_SLOTS %d" % len(keyword_slots),
+        "",
+    ]
+    emit_array(lines, "static const uint16_t command_displacements[COMMAND_BUCKETS]",
+               ["%d," % d for d in command_displacements], 12)
+    lines.append("")
+    lines.append("static const SignatureSlot command_slots[COMMAND_SLOTS] = {")
+    for slot in command_slots:
+        if slot is None:
+            lines.append("    { NULL, 0, 0 },")
+        else:
+            lines.append("    { %s, %d, %d }," % (c_string(slot[0]), len(slot[0]), slot[1]))
+    lines.append("};")
+    lines.append("")
+    emit_array(lines, "static const uint16_t keyword_displacements[KEYWORD_BUCKETS]",
+               ["%d," % d for d in keyword_displacements], 12)
+    lines.append("")
+    lines.append("static const SignatureSlot keyword_slots[KEYWORD_SLOTS] = {")
+    for slot in keyword_slots:
+        if slot is None:
+            lines.append("    { NULL, 0, 0 },")
+        else:
+            lines.append("    { %s, %d, %d }, // %s" % (c_string(slot[0]), len(slot[0]), slot[1],
+                                                       signatures[slot[1]][0]))
+    lines.append("};")
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    text = generate()
+    if "--check" in sys.argv[1:]:
+        with open(OUTPUT) as f:
+            if f.read() != text:
+                sys.exit("signatures.inc is out of date; run tools/gen_signatures.py")
+        return
+    with open(OUTPUT, "w") as f:
+        f.write(text)
+
+
+if __name__ == "__main__":
+    main()
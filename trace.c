@@ -0,0 +1,145 @@
+#include "trace.h"
+#include "json.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    const char *name;
+    const char *path;
+    uint64_t start;
+    uint64_t duration;
+    size_t bytes;
+} TraceEvent;
+
+typedef struct TraceBuffer {
+    int tid;
+    TraceEvent *events;
+    size_t count;
+    size_t capacity;
+    char **paths; // from trace_path()
+    size_t path_count;
+    size_t path_capacity;
+    struct TraceBuffer *next;
+} TraceBuffer;
+
+static bool enabled;
+static uint64_t epoch;
+// Buffers outlive their threads; they are only released by trace_write().
+static pthread_mutex_t buffers_lock = PTHREAD_MUTEX_INITIALIZER;
+static TraceBuffer *buffers;
+static int next_tid = 1;
+static _Thread_local TraceBuffer *local;
+
+static uint64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+void trace_enable(void) {
+    epoch = monotonic_us();
+    enabled = true;
+}
+
+bool trace_enabled(void) {
+    return enabled;
+}
+
+uint64_t trace_now(void) {
+    return enabled ? monotonic_us() - epoch : 0;
+}
+
+static TraceBuffer *thread_buffer(void) {
+    if (!local) {
+        local = calloc(1, sizeof(TraceBuffer));
+        pthread_mutex_lock(&buffers_lock);
+        local->tid = next_tid++;
+        local->next = buffers;
+        buffers = local;
+        pthread_mutex_unlock(&buffers_lock);
+    }
+    return local;
+}
+
+const char *trace_path(const char *path) {
+    if (!enabled || !path) return path;
+    TraceBuffer *buffer = thread_buffer();
+    if (buffer->path_count == buffer->path_capacity) {
+        buffer->path_capacity = buffer->path_capacity == 0 ? 16 : buffer->path_capacity * 2;
+        buffer->paths = realloc(buffer->paths, buffer->path_capacity * sizeof(char *));
+    }
+    return buffer->paths[buffer->path_count++] = strdup(path);
+}
+
+void trace_span(const char *name, uint64_t start, const char *path, size_t bytes) {
+    if (!enabled) return;
+    uint64_t end = trace_now();
+    TraceBuffer *buffer = thread_buffer();
+    if (buffer->count == buffer->capacity) {
+        buffer->capacity = buffer->capacity == 0 ? 64 : buffer->capacity * 2;
+        buffer->events = realloc(buffer->events, buffer->capacity * sizeof(TraceEvent));
+    }
+    buffer->events[buffer->count++] = (TraceEvent){
+        .name = name,
+        .path = path,
+        .start = start,
+        .duration = end - start,
+        .bytes = bytes,
+    };
+}
+
+bool trace_write(const char *path) {
+    FormatBuffer out = {0};
+    bool first = true;
+    json_write_raw(&out, "{\"traceEvents\":[");
+
+    pthread_mutex_lock(&buffers_lock);
+    TraceBuffer *buffer = buffers;
+    buffers = NULL;
+    pthread_mutex_unlock(&buffers_lock);
+
+    while (buffer) {
+        for (size_t i = 0; i < buffer->count; i++) {
+            TraceEvent *event = &buffer->events[i];
+            json_write_raw(&out, first ? "\n" : ",\n");
+            first = false;
+            json_write_raw(&out, "{\"name\":");
+            json_write_string(&out, event->name, strlen(event->name));
+            json_write_raw(&out, ",\"ph\":\"X\",\"pid\":1,\"tid\":");
+            json_write_int(&out, buffer->tid);
+            json_write_raw(&out, ",\"ts\":");
+            json_write_int(&out, (long long)event->start);
+            json_write_raw(&out, ",\"dur\":");
+            json_write_int(&out, (long long)event->duration);
+            json_write_raw(&out, ",\"args\":{");
+            if (event->path) {
+                json_write_raw(&out, "\"path\":");
+                json_write_string(&out, event->path, strlen(event->path));
+                json_write_raw(&out, ",");
+            }
+            json_write_raw(&out, "\"bytes\":");
+            json_write_int(&out, (long long)event->bytes);
+            json_write_raw(&out, "}}");
+        }
+        TraceBuffer *next = buffer->next;
+        if (buffer == local) local = NULL;
+        for (size_t i = 0; i < buffer->path_count; i++) free(buffer->paths[i]);
+        free(buffer->paths);
+        free(buffer->events);
+        free(buffer);
+        buffer = next;
+    }
+    json_write_raw(&out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+    FILE *f = fopen(path, "wb");
+    bool ok = f != NULL;
+    if (f) {
+        ok = fwrite(out.data, 1, out.length, f) == out.length;
+        ok = fclose(f) == 0 && ok;
+    }
+    format_buffer_free(&out);
+    return ok;
+}
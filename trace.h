@@ -0,0 +1,32 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Timeline recording in Chrome Trace Event format, for Perfetto or
+// chrome://tracing. Spans go to a buffer owned by the recording thread, so
+// threads never contend while tracing; everything is written out once by
+// trace_write(). When tracing is off, every call is a flag check.
+
+void trace_enable(void);
+bool trace_enabled(void);
+
+// Microseconds since trace_enable().
+uint64_t trace_now(void);
+
+// A copy of `path` that lives until trace_write(), made once per file before
+// its spans start so that recording them does not allocate. Returns `path`
+// itself when tracing is off.
+const char *trace_path(const char *path);
+
+// Records a complete span from `start` (a trace_now() value) until now.
+// `name` must be a string literal. `path` is kept, not copied, so it must
+// outlive trace_write() (argv, or from trace_path()); it may be NULL.
+void trace_span(const char *name, uint64_t start, const char *path, size_t bytes);
+
+// Writes every recorded span to `path` and releases the buffers.
+bool trace_write(const char *path);
+
+#endif
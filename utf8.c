@@ -0,0 +1,153 @@
+#include "utf8.h"
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+// Length of the leading run of ASCII bytes.
+static size_t ascii_prefix(const unsigned char *s, size_t length) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 32 <= length; i += 32) {
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)(s + i)));
+        if (mask) return i + (size_t)__builtin_ctz(mask);
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i + 16 <= length; i += 16) {
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(s + i)));
+        if (mask) return i + (size_t)__builtin_ctz(mask);
+    }
+#elif defined(__wasm_simd128__)
+    for (; i + 16 <= length; i += 16) {
+        unsigned mask = (unsigned)wasm_i8x16_bitmask(wasm_v128_load(s + i));
+        if (mask) return i + (size_t)__builtin_ctz(mask);
+    }
+#endif
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, s + i, 8);
+        if (word & 0x8080808080808080ull) break;
+    }
+    while (i < length && s[i] < 0x80) i++;
+    return i;
+}
+
+// Decodes one multi-byte sequence starting at s[0] >= 0x80. Returns its
+// length, or 0 if it is malformed (overlong, surrogate, out of range or cut
+// short).
+static size_t decode(const unsigned char *s, size_t available, uint32_t *cp) {
+    unsigned char lead = s[0];
+    size_t n;
+    unsigned char lo = 0x80, hi = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        n = 2;
+        *cp = lead & 0x1F;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        n = 3;
+        *cp = lead & 0x0F;
+        if (lead == 0xE0) lo = 0xA0;
+        if (lead == 0xED) hi = 0x9F;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        n = 4;
+        *cp = lead & 0x07;
+        if (lead == 0xF0) lo = 0x90;
+        if (lead == 0xF4) hi = 0x8F;
+    } else {
+        return 0;
+    }
+    if (available < n) return 0;
+    if (s[1] < lo || s[1] > hi) return 0;
+    *cp = (*cp << 6) | (s[1] & 0x3F);
+    for (size_t k = 2; k < n; k++) {
+        if ((s[k] & 0xC0) != 0x80) return 0;
+        *cp = (*cp << 6) | (s[k] & 0x3F);
+    }
+    return n;
+}
+
+typedef struct {
+    uint32_t first;
+    uint32_t last;
+} CodeRange;
+
+static const CodeRange zero_width[] = {
+    { 0x0300, 0x036F }, { 0x0483, 0x0489 }, { 0x0591, 0x05BD }, { 0x0610, 0x061A },
+    { 0x064B, 0x065F }, { 0x0E31, 0x0E31 }, { 0x0E34, 0x0E3A }, { 0x0E47, 0x0E4E },
+    { 0x1AB0, 0x1AFF }, { 0x1DC0, 0x1DFF }, { 0x200B, 0x200F }, { 0x2028, 0x202E },
+    { 0x2060, 0x2064 }, { 0x20D0, 0x20FF }, { 0xFE00, 0xFE0F }, { 0xFE20, 0xFE2F },
+    { 0xFEFF, 0xFEFF }, { 0xE0100, 0xE01EF },
+};
+
+static const CodeRange wide[] = {
+    { 0x1100, 0x115F }, { 0x231A, 0x231B }, { 0x2329, 0x232A }, { 0x23E9, 0x23EC },
+    { 0x25FD, 0x25FE }, { 0x2614, 0x2615 }, { 0x2E80, 0x303E }, { 0x3041, 0x33FF },
+    { 0x3400, 0x4DBF }, { 0x4E00, 0x9FFF }, { 0xA000, 0xA4CF }, { 0xAC00, 0xD7A3 },
+    { 0xF900, 0xFAFF }, { 0xFE30, 0xFE4F }, { 0xFF00, 0xFF60 }, { 0xFFE0, 0xFFE6 },
+    { 0x1F300, 0x1F64F }, { 0x1F900, 0x1F9FF }, { 0x20000, 0x2FFFD }, { 0x30000, 0x3FFFD },
+};
+
+static bool in_ranges(uint32_t cp, const CodeRange *ranges, size_t count) {
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (cp < ranges[mid].first) hi = mid;
+        else if (cp > ranges[mid].last) lo = mid + 1;
+        else return true;
+    }
+    return false;
+}
+
+static size_t code_point_width(uint32_t cp) {
+    if (in_ranges(cp, zero_width, sizeof(zero_width) / sizeof(zero_width[0]))) return 0;
+    if (in_ranges(cp, wide, sizeof(wide) / sizeof(wide[0]))) return 2;
+    return 1;
+}
+
+size_t utf8_display_width(const char *text, size_t length) {
+    const unsigned char *s = (const unsigned char *)text;
+    size_t width = 0;
+    size_t i = 0;
+    while (i < length) {
+        size_t run = ascii_prefix(s + i, length - i);
+        width += run;
+        i += run;
+        // Decode the non-ASCII stretch up to the next ASCII byte.
+        while (i < length && s[i] >= 0x80) {
+            uint32_t cp;
+            size_t n = decode(s + i, length - i, &cp);
+            if (n == 0) {
+                width++;
+                i++;
+            } else {
+                width += code_point_width(cp);
+                i += n;
+            }
+        }
+    }
+    return width;
+}
+
+bool utf8_validate(const char *text, size_t length, size_t *error_offset) {
+    const unsigned char *s = (const unsigned char *)text;
+    size_t i = 0;
+    while (i < length) {
+        i += ascii_prefix(s + i, length - i);
+        while (i < length && s[i] >= 0x80) {
+            uint32_t cp;
+            size_t n = decode(s + i, length - i, &cp);
+            if (n == 0) {
+                if (error_offset) *error_offset = i;
+                return false;
+            }
+            i += n;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,17 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Number of terminal columns `text` occupies: East Asian wide and emoji code
+// points take two columns, combining marks and zero-width characters none,
+// everything else one. Each byte of an invalid sequence counts as one column.
+// ASCII runs are checked 16 (32 with AVX2) bytes at a time.
+size_t utf8_display_width(const char *text, size_t length);
+
+// Returns true if `text` is well-formed UTF-8. Otherwise stores the offset of
+// the first invalid byte in *error_offset (if non-NULL).
+bool utf8_validate(const char *text, size_t length, size_t *error_offset);
+
+#endif
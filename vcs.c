@@ -0,0 +1,106 @@
+#include "vcs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool is_cmake_path(const char *path) {
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    size_t n = strlen(path);
+    return strcmp(base, "CMakeLists.txt") == 0 || (n > 6 && strcmp(path + n - 6, ".cmake") == 0);
+}
+
+// Single-quotes an argument for the shell.
+static void append_quoted(char *dst, size_t size, const char *arg) {
+    size_t n = strlen(dst);
+    if (n + 1 < size) dst[n++] = '\'';
+    for (; *arg && n + 5 < size; arg++) {
+        if (*arg == '\'') {
+            memcpy(dst + n, "'\\''", 4);
+            n += 4;
+        } else {
+            dst[n++] = *arg;
+        }
+    }
+    if (n + 1 < size) dst[n++] = '\'';
+    dst[n] = '\0';
+}
+
+static void add_range(ChangedFile *file, int first, int last) {
+    file->ranges = realloc(file->ranges, (file->range_count + 1) * sizeof(LineRange));
+    file->ranges[file->range_count++] = (LineRange){ first, last };
+}
+
+bool vcs_changed_files(const char *rev, ChangedFileList *out) {
+    out->files = NULL;
+    out->count = 0;
+
+    // --relative keeps paths usable from the current directory; -U0 limits
+    // the output to the hunk headers and changed lines. The prefixes are given
+    // explicitly because diff.noprefix and diff.mnemonicPrefix change them.
+    char command[4096] = "git -c core.quotepath=off diff --relative -U0 --no-color --no-ext-diff "
+                         "--src-prefix=a/ --dst-prefix=b/ --diff-filter=ACMR ";
+    append_quoted(command, sizeof(command), rev);
+    strncat(command, " -- '*.cmake' '*CMakeLists.txt'", sizeof(command) - strlen(command) - 1);
+
+    FILE *pipe = popen(command, "r");
+    if (!pipe) return false;
+
+    char line[8192];
+    ChangedFile *current = NULL;
+    // The "--- "/"+++ " file headers only count between a "diff " line and
+    // the first hunk; inside a hunk they are changed lines starting "-- " or
+    // "++ ", say in a bracket argument.
+    bool in_header = false, old_header = false;
+    while (fgets(line, sizeof(line), pipe)) {
+        bool after_old = old_header;
+        old_header = in_header && strncmp(line, "--- ", 4) == 0;
+        if (strncmp(line, "diff ", 5) == 0) {
+            current = NULL;
+            in_header = true;
+        } else if (after_old && strncmp(line, "+++ ", 4) == 0) {
+            char *path = line + 4;
+            path[strcspn(path, "\t\n")] = '\0';
+            if (strncmp(path, "b/", 2) != 0) continue; // /dev/null
+            path += 2;
+            if (!is_cmake_path(path)) continue;
+            out->files = realloc(out->files, (out->count + 1) * sizeof(ChangedFile));
+            current = &out->files[out->count++];
+            current->path = strdup(path);
+            current->ranges = NULL;
+            current->range_count = 0;
+        } else if (strncmp(line, "@@ ", 3) == 0) {
+            in_header = false;
+            if (!current) continue;
+            // @@ -a[,b] +c[,d] @@
+            const char *plus = strchr(line + 3, '+');
+            if (!plus) continue;
+            char *end;
+            long first = strtol(plus + 1, &end, 10);
+            long count = 1;
+            if (*end == ',') count = strtol(end + 1, NULL, 10);
+            if (count == 0) {
+                add_range(current, (int)first + 1, (int)first);
+            } else {
+                add_range(current, (int)first, (int)(first + count - 1));
+            }
+        }
+    }
+
+    int status = pclose(pipe);
+    if (status != 0) {
+        vcs_changed_files_free(out);
+        return false;
+    }
+    return true;
+}
+
+void vcs_changed_files_free(ChangedFileList *list) {
+    for (size_t i = 0; i < list->count; i++) {
+        free(list->files[i].path);
+        free(list->files[i].ranges);
+    }
+    free(list->files);
+    list->files = NULL;
+    list->count = 0;
+}
@@ -0,0 +1,31 @@
+#ifndef VCS_H
+#define VCS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// 1-based inclusive line range on the new side of a diff. A range with
+// last < first marks a pure deletion just before line `first`.
+typedef struct {
+    int first;
+    int last;
+} LineRange;
+
+typedef struct {
+    char *path;
+    LineRange *ranges;
+    size_t range_count;
+} ChangedFile;
+
+typedef struct {
+    ChangedFile *files;
+    size_t count;
+} ChangedFileList;
+
+// Lists the CMake files (CMakeLists.txt, *.cmake) that differ between `rev`
+// and the working tree, with the changed line ranges of each, by running
+// `git diff -U0` once. Paths are relative to the current directory.
+bool vcs_changed_files(const char *rev, ChangedFileList *out);
+void vcs_changed_files_free(ChangedFileList *list);
+
+#endif
@@ -0,0 +1,80 @@
+#include "verify.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define DIGEST_SEED 0x9E3779B97F4A7C15ULL
+#define DIGEST_PRIME 0x100000001B3ULL
+
+static bool is_trivia(TokenType type) {
+    return type == TOKEN_SPACE || type == TOKEN_NEWLINE;
+}
+
+static Token next_significant(Lexer *lexer) {
+    Token token;
+    do {
+        token = lexer_next_token(lexer);
+    } while (is_trivia(token.type));
+    return token;
+}
+
+void token_digest(const char *source, TokenDigest *digest) {
+    Lexer lexer;
+    lexer_init(&lexer, source);
+
+    uint64_t hash = DIGEST_SEED;
+    size_t count = 0;
+    for (;;) {
+        Token token = next_significant(&lexer);
+        if (token.type == TOKEN_EOF) break;
+        // The type and length separate tokens, so "a b" and "ab" differ.
+        hash = (hash ^ (uint64_t)token.type) * DIGEST_PRIME;
+        hash = (hash ^ (uint64_t)token.length) * DIGEST_PRIME;
+        const unsigned char *p = (const unsigned char *)token_text(source, token);
+        for (SourceOffset i = 0; i < token.length; i++) {
+            hash = (hash ^ p[i]) * DIGEST_PRIME;
+        }
+        count++;
+    }
+    digest->hash = hash;
+    digest->token_count = count;
+}
+
+static void report_mismatch(const char *path, const char *source, size_t source_length,
+                            const char *formatted, FILE *diagnostics) {
+    // Only on failure: walk both token streams to locate the difference.
+    Lexer a, b;
+    lexer_init(&a, source);
+    lexer_init(&b, formatted);
+    Token ta, tb;
+    for (;;) {
+        ta = next_significant(&a);
+        tb = next_significant(&b);
+        if (ta.type != tb.type || ta.length != tb.length ||
+            memcmp(token_text(source, ta), token_text(formatted, tb), ta.length) != 0) {
+            break;
+        }
+        if (ta.type == TOKEN_EOF) return;
+    }
+
+    LineIndex lines;
+    int line, column;
+    line_index_build(&lines, source, source_length);
+    line_index_lookup(&lines, ta.offset, &line, &column);
+    line_index_free(&lines);
+
+    fprintf(diagnostics, "%s:%d:%d: error: formatting changed the token stream; "
+                         "'%.*s' became '%.*s'\n",
+            path, line, column,
+            (int)(ta.length > 40 ? 40 : ta.length), token_text(source, ta),
+            (int)(tb.length > 40 ? 40 : tb.length), token_text(formatted, tb));
+}
+
+bool verify_formatting(const char *path, const char *source, size_t source_length,
+                       const char *formatted, FILE *diagnostics) {
+    TokenDigest before, after;
+    token_digest(source, &before);
+    token_digest(formatted, &after);
+    if (before.hash == after.hash && before.token_count == after.token_count) return true;
+    report_mismatch(path, source, source_length, formatted, diagnostics);
+    return false;
+}
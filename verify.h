@@ -0,0 +1,23 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include "lexer.h"
+#include <stdint.h>
+#include <stdio.h>
+
+// Hash of the significant tokens of a source (everything but spaces and
+// newlines), used to prove that formatting changed whitespace only.
+typedef struct {
+    uint64_t hash;
+    size_t token_count;
+} TokenDigest;
+
+void token_digest(const char *source, TokenDigest *digest);
+
+// Checks that `formatted` (NUL-terminated, like `source`) has the same
+// significant tokens as `source`. On mismatch, reports the first differing
+// token to `diagnostics` (prefixed with `path`) and returns false.
+bool verify_formatting(const char *path, const char *source, size_t source_length,
+                       const char *formatted, FILE *diagnostics);
+
+#endif
@@ -0,0 +1,214 @@
+#include "watch.h"
+#include <stdio.h>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_MOVED_FROM | IN_DELETE_SELF | IN_ONLYDIR)
+
+typedef struct {
+    char *path;
+    int64_t mtime_ns;
+    int64_t size;
+    uint64_t inode;
+} Fingerprint;
+
+typedef struct {
+    int fd;
+    char **dirs; // indexed by watch descriptor
+    size_t dir_capacity;
+    char **dirty;
+    size_t dirty_count;
+    Fingerprint *seen;
+    size_t seen_count;
+    bool warned_limit;
+} Watcher;
+
+static bool is_watched_file(const char *name) {
+    size_t n = strlen(name);
+    return strcmp(name, "CMakeLists.txt") == 0 || strcmp(name, ".cmake_format") == 0 ||
+           (n > 6 && strcmp(name + n - 6, ".cmake") == 0);
+}
+
+static char *join_path(const char *dir, const char *name) {
+    size_t a = strlen(dir), b = strlen(name);
+    char *path = malloc(a + b + 2);
+    memcpy(path, dir, a);
+    path[a] = '/';
+    memcpy(path + a + 1, name, b + 1);
+    return path;
+}
+
+static void mark_dirty(Watcher *w, const char *path) {
+    for (size_t i = 0; i < w->dirty_count; i++) {
+        if (strcmp(w->dirty[i], path) == 0) return;
+    }
+    w->dirty = realloc(w->dirty, (w->dirty_count + 1) * sizeof(char *));
+    w->dirty[w->dirty_count++] = strdup(path);
+}
+
+// Watches `dir` and everything below it. With `dirty`, the CMake files found
+// are queued too: they appeared together with a new directory.
+static void add_tree(Watcher *w, const char *dir, bool dirty) {
+    char *cache = join_path(dir, "CMakeCache.txt");
+    bool build_tree = access(cache, F_OK) == 0;
+    free(cache);
+    if (build_tree) return;
+
+    int wd = inotify_add_watch(w->fd, dir, WATCH_MASK);
+    if (wd < 0) {
+        if (errno == ENOSPC && !w->warned_limit) {
+            fprintf(stderr, "%s: inotify watch limit reached; raise fs.inotify.max_user_watches\n", dir);
+            w->warned_limit = true;
+        } else if (errno != ENOSPC) {
+            perror(dir);
+        }
+        return;
+    }
+    if ((size_t)wd >= w->dir_capacity) {
+        size_t capacity = w->dir_capacity ? w->dir_capacity : 64;
+        while (capacity <= (size_t)wd) capacity *= 2;
+        w->dirs = realloc(w->dirs, capacity * sizeof(char *));
+        memset(w->dirs + w->dir_capacity, 0, (capacity - w->dir_capacity) * sizeof(char *));
+        w->dir_capacity = capacity;
+    }
+    free(w->dirs[wd]);
+    w->dirs[wd] = strdup(dir);
+
+    DIR *d = opendir(dir);
+    if (!d) return;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (entry->d_name[0] == '.' && strcmp(entry->d_name, ".cmake_format") != 0) continue;
+        char *path = join_path(dir, entry->d_name);
+        // lstat: a symlinked directory is not followed, so the walk stays
+        // inside the root and cannot loop.
+        struct stat st;
+        if (lstat(path, &st) == 0) {
+            if (S_ISDIR(st.st_mode)) {
+                add_tree(w, path, dirty);
+            } else if (dirty && is_watched_file(entry->d_name)) {
+                mark_dirty(w, path);
+            }
+        }
+        free(path);
+    }
+    closedir(d);
+}
+
+static void read_events(Watcher *w) {
+    char buffer[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t n = read(w->fd, buffer, sizeof(buffer));
+    for (char *p = buffer; n > 0 && p < buffer + n;) {
+        const struct inotify_event *event = (const struct inotify_event *)p;
+        p += sizeof(struct inotify_event) + event->len;
+
+        if (event->mask & IN_Q_OVERFLOW) {
+            fprintf(stderr, "inotify queue overflowed; some changes were missed\n");
+            continue;
+        }
+        if (event->wd < 0 || (size_t)event->wd >= w->dir_capacity || !w->dirs[event->wd]) continue;
+        if (event->mask & IN_IGNORED) {
+            free(w->dirs[event->wd]);
+            w->dirs[event->wd] = NULL;
+            continue;
+        }
+        if (event->len == 0) continue;
+
+        char *path = join_path(w->dirs[event->wd], event->name);
+        if (event->mask & IN_ISDIR) {
+            // A directory created or moved in; one moved out drops its watches
+            // with IN_IGNORED once it is deleted.
+            if ((event->mask & (IN_CREATE | IN_MOVED_TO)) && event->name[0] != '.') add_tree(w, path, true);
+        } else if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) && is_watched_file(event->name)) {
+            mark_dirty(w, path);
+        }
+        free(path);
+    }
+}
+
+static Fingerprint *find_seen(Watcher *w, const char *path) {
+    for (size_t i = 0; i < w->seen_count; i++) {
+        if (strcmp(w->seen[i].path, path) == 0) return &w->seen[i];
+    }
+    return NULL;
+}
+
+static bool same_file_state(const Fingerprint *f, const struct stat *st) {
+    return f->size == (int64_t)st->st_size && f->inode == (uint64_t)st->st_ino &&
+           f->mtime_ns == (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+static void run_handler(Watcher *w, const char *path, WatchHandler handler, void *context) {
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) return;
+    Fingerprint *seen = find_seen(w, path);
+    if (seen && same_file_state(seen, &st)) return;
+
+    handler(path, context);
+
+    if (stat(path, &st) != 0) return;
+    if (!seen) {
+        w->seen = realloc(w->seen, (w->seen_count + 1) * sizeof(Fingerprint));
+        seen = &w->seen[w->seen_count++];
+        seen->path = strdup(path);
+    }
+    seen->size = (int64_t)st.st_size;
+    seen->inode = (uint64_t)st.st_ino;
+    seen->mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+bool watch_run(const char *root, int debounce_ms, WatchHandler handler, void *context) {
+    Watcher w = {0};
+    w.fd = inotify_init1(IN_CLOEXEC);
+    if (w.fd < 0) {
+        perror("inotify_init1");
+        return false;
+    }
+    add_tree(&w, root, false);
+    if (w.dir_capacity == 0) {
+        close(w.fd);
+        return false;
+    }
+
+    struct pollfd pfd = { w.fd, POLLIN, 0 };
+    for (;;) {
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+        read_events(&w);
+        // Wait out the rest of the burst.
+        while (poll(&pfd, 1, debounce_ms) > 0) read_events(&w);
+
+        for (size_t i = 0; i < w.dirty_count; i++) {
+            run_handler(&w, w.dirty[i], handler, context);
+            free(w.dirty[i]);
+        }
+        w.dirty_count = 0;
+    }
+
+    close(w.fd);
+    return false;
+}
+
+#else
+
+bool watch_run(const char *root, int debounce_ms, WatchHandler handler, void *context) {
+    (void)debounce_ms;
+    (void)handler;
+    (void)context;
+    fprintf(stderr, "%s: --watch needs inotify and is only available on Linux\n", root);
+    return false;
+}
+
+#endif
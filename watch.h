@@ -0,0 +1,20 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <stdbool.h>
+
+// Called with the path of each CMake file (CMakeLists.txt, *.cmake) or
+// .cmake_format that changed.
+typedef void (*WatchHandler)(const char *path, void *context);
+
+// Watches `root` and every directory below it with inotify, skipping hidden
+// directories, build trees (those holding a CMakeCache.txt) and symlinks to
+// directories, which could lead out of `root` or back into it. Events are
+// collected until none has arrived for `debounce_ms`, so the write-to-temp
+// and rename an editor does on save ends up as one call per file. A file
+// whose size, mtime and inode are still what they were after the handler last
+// ran for it is skipped; that is how the handler's own writes are ignored.
+// Runs until the process is killed; returns false if watching fails.
+bool watch_run(const char *root, int debounce_ms, WatchHandler handler, void *context);
+
+#endif